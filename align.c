@@ -38,50 +38,625 @@
  * where a header object begins, given the tail.
  */
 /* C >= C99 required for SIZE_MAX */
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "align.h"
 
-static int size_sorter(const void * a, const void * b);
+/*
+ * Checked addition of size_t values: stores A + B into *Result and yields
+ * non-zero if that overflowed.  Result must not point to A nor to B
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 202311L
+#include <stdckdint.h>
+#define DAddOverflows(Result, A, B) ckd_add((Result), (A), (B))
+#elif defined(__GNUC__) && __GNUC__ >= 5
+#define DAddOverflows(Result, A, B) __builtin_add_overflow((A), (B), (Result))
+#elif defined(__has_builtin)
+#if __has_builtin(__builtin_add_overflow)
+#define DAddOverflows(Result, A, B) __builtin_add_overflow((A), (B), (Result))
+#endif
+#endif
+#ifndef DAddOverflows
+/* Unsigned addition wraps, so an overflowed sum is less than an addend */
+#define DAddOverflows(Result, A, B) ((*(Result) = (A) + (B)) < (A))
+#endif
+
+/*
+ * TailAlignedSizeBatch has an AVX2 kernel for 64-bit x86, chosen at
+ * run-time.  SSE2 lacks the 64-bit comparisons it would need
+ */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__ILP32__)
+#define DAlignAvx2 1
+#include <immintrin.h>
+#endif
+
+/*
+ * With DAlignSmallTable defined, TailAlignedSize and PaddingSize look up
+ * the factors of sizes below DAlignSmallLimit in a table of exponents,
+ * instead of isolating the lowest set bit.  The table is a constant built
+ * by the preprocessor, so it needs no initialization and may be shared by
+ * threads.  It costs DAlignSmallLimit bytes (4 KiB) of read-only data, and
+ * a lookup is a load which could miss the cache where the bit operations
+ * cannot, so which is faster depends on the platform and on the workload:
+ * build bench.c with and without it to choose
+ */
+#ifdef DAlignSmallTable
+#define DAlignSmallLimit 4096
+/* The exponents of the factors of 1 to 2^N - 1: a ruler sequence */
+#define DRuler1 0
+#define DRuler2 DRuler1, 1, DRuler1
+#define DRuler3 DRuler2, 2, DRuler2
+#define DRuler4 DRuler3, 3, DRuler3
+#define DRuler5 DRuler4, 4, DRuler4
+#define DRuler6 DRuler5, 5, DRuler5
+#define DRuler7 DRuler6, 6, DRuler6
+#define DRuler8 DRuler7, 7, DRuler7
+#define DRuler9 DRuler8, 8, DRuler8
+#define DRuler10 DRuler9, 9, DRuler9
+#define DRuler11 DRuler10, 10, DRuler10
+#define DRuler12 DRuler11, 11, DRuler11
+#endif
+
+/*
+ * Arrays of up to this many elements are sorted in place, where the
+ * allocations and passes of the radix sort would cost more than they save
+ */
+#define DAlignSortInPlace 32
+
+/* Used by sort_descending: a sort key and the index of its element */
+struct sort_item
+  {
+    size_t key;
+    size_t index;
+  };
+
+static struct sort_item * radix_sort(
+    struct sort_item * Items,
+    struct sort_item * Spare,
+    size_t Count
+  );
+#ifdef DAlignSmallTable
+static size_t small_tail_aligned_size(size_t HeadSize, size_t TailSize);
+#endif
+static size_t sort_alignment(const char * Element, size_t AlignOffset);
+static void sort_descending(
+    size_t * Array,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  );
+static void sort_in_place(
+    char * Bytes,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  );
+static void sort_merge(
+    char * Bytes,
+    size_t Left,
+    size_t Right,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  );
+static int sort_precedes(
+    const char * Left,
+    const char * Right,
+    int ByAlignment,
+    size_t AlignOffset
+  );
+static void sort_rotate(char * Bytes, size_t Left, size_t Count, size_t Size);
+static void swap_sort(
+    char * Bytes,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  );
+static size_t explicit_alignment(size_t Size, size_t Align);
+static size_t tail_aligned_size(
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Factor,
+    struct tail_layout * Layout
+  );
+#ifdef DAlignAvx2
+static size_t tail_aligned_size_avx2(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  ) __attribute__((target("avx2")));
+static size_t tail_aligned_size32_avx2(
+    const uint32_t * Heads,
+    const uint32_t * Tails,
+    uint32_t * Out,
+    size_t Count
+  ) __attribute__((target("avx2")));
+#endif
+static size_t tail_array(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign,
+    size_t * Factor
+  );
+static size_t tail_layout(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Factor
+  );
+
+void * AllocHeadTail(size_t HeadSize, size_t TailSize, void ** Tail)
+  {
+    struct tail_layout layout;
+
+    TailLayout(&layout, HeadSize, TailSize);
+    return TailLayoutAlloc(&layout, Tail);
+  }
+
+/*
+ * Used by TailAlignedSizeMulti, tail_array and TailLayoutEx.  Returns
+ * Align, or the factor for Size if Align is zero, or zero if Align is not a
+ * power of two
+ */
+static size_t explicit_alignment(size_t Size, size_t Align)
+  {
+    if (!Align)
+      return LargestPowerOfTwoFactor(Size);
+    if (Align & (Align - 1))
+      return 0;
+    return Align;
+  }
+
+void FreeHeadTail(void * Head)
+  {
+    free(Head);
+  }
+
+void * HeadFromTail(void * Tail, const struct tail_layout * Layout)
+  {
+    return (char *) Tail - Layout->tail_offset;
+  }
 
 size_t LargestPowerOfTwoFactor(size_t Number)
   {
-    size_t npow;
-    size_t pow;
+    /* The lowest set bit is the factor, so no loop nor division is needed */
+    return DLargestPowerOfTwoFactor(Number);
+  }
+
+uint32_t LargestPowerOfTwoFactor32(uint32_t Number)
+  {
+    uint32_t factor;
+
+    /* The lowest set bit, as for LargestPowerOfTwoFactor */
+    factor = Number & (~Number + 1);
+    return factor > DMaxPowerOfTwoFactor32 ?
+      DMaxPowerOfTwoFactor32 :
+      factor | !Number;
+  }
+
+size_t PaddingSize(size_t HeadSize, size_t TailSize)
+  {
+    struct tail_layout layout;
 
-    npow = pow = 1;
-    while (Number >= npow && !(Number % npow) && SIZE_MAX - npow >= npow)
+#ifdef DAlignSmallTable
+    if ((HeadSize | TailSize) < DAlignSmallLimit && HeadSize && TailSize)
+      return small_tail_aligned_size(HeadSize, TailSize) - HeadSize -
+        TailSize;
+#endif
+    TailLayout(&layout, HeadSize, TailSize);
+    return layout.padding;
+  }
+
+uint32_t PaddingSize32(uint32_t HeadSize, uint32_t TailSize)
+  {
+    uint32_t total_size;
+
+    total_size = TailAlignedSize32(HeadSize, TailSize);
+    return total_size ? total_size - TailSize - HeadSize : UINT32_MAX;
+  }
+
+size_t PaddingSizeEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    struct tail_layout layout;
+
+    TailLayoutEx(&layout, HeadSize, HeadAlign, TailSize, TailAlign);
+    return layout.padding;
+  }
+
+/*
+ * Used by sort_descending.  Sorts Count items into descending order of
+ * their keys, using Spare for as many items.  This is a stable
+ * least-significant-digit radix sort, one byte per pass, and passes for
+ * bytes which are the same in every key are skipped.  Returns whichever of
+ * Items and Spare holds the result
+ */
+static struct sort_item * radix_sort(
+    struct sort_item * Items,
+    struct sort_item * Spare,
+    size_t Count
+  )
+  {
+    size_t bucket;
+    size_t * buckets;
+    size_t counts[sizeof (size_t)][UCHAR_MAX + 1];
+    size_t digit;
+    size_t i;
+    size_t n;
+    size_t position;
+    unsigned int shift;
+    struct sort_item * swap;
+
+    /* Count every digit of every key at once */
+    memset(counts, 0, sizeof counts);
+    for (i = 0; i < Count; ++i)
       {
-        pow = npow;
-        npow *= 2;
+        for (digit = 0; digit < sizeof (size_t); ++digit)
+          {
+            shift = (unsigned int) digit * CHAR_BIT;
+            ++counts[digit][(Items[i].key >> shift) & UCHAR_MAX];
+          }
+      }
+
+    for (digit = 0; digit < sizeof (size_t); ++digit)
+      {
+        shift = (unsigned int) digit * CHAR_BIT;
+        buckets = counts[digit];
+        if (buckets[(Items->key >> shift) & UCHAR_MAX] == Count)
+          continue;
+
+        /* Turn counts into positions, with the greatest digits first */
+        for ((position = 0), (bucket = UCHAR_MAX + 1); bucket--; )
+          {
+            n = buckets[bucket];
+            buckets[bucket] = position;
+            position += n;
+          }
+
+        for (i = 0; i < Count; ++i)
+          Spare[buckets[(Items[i].key >> shift) & UCHAR_MAX]++] = Items[i];
+        swap = Items;
+        Items = Spare;
+        Spare = swap;
       }
-    return pow;
+    return Items;
   }
 
-size_t PaddingSize(size_t HeadSize, size_t TailSize)
+#ifdef DAlignSmallTable
+/*
+ * Used by PaddingSize and TailAlignedSize.  Same result as TailAlignedSize
+ * for sizes below DAlignSmallLimit, whose sum cannot overflow.  A result
+ * for a zero size is masked away, as in tail_aligned_size
+ */
+static size_t small_tail_aligned_size(size_t HeadSize, size_t TailSize)
   {
-    size_t total_size;
+    /* The factor of zero is one, as for LargestPowerOfTwoFactor */
+    static const unsigned char exponents[DAlignSmallLimit] = { 0, DRuler12 };
+    size_t mask;
 
-    total_size = TailAlignedSize(HeadSize, TailSize);
-    if (!total_size)
-      return SIZE_MAX;
-    return total_size - TailSize - HeadSize;
+    mask = exponents[HeadSize] > exponents[TailSize] ?
+      exponents[HeadSize] :
+      exponents[TailSize];
+    mask = ((size_t) 1 << mask) - 1;
+    return (HeadSize + TailSize + mask) & ~mask &
+      ((size_t) 0 - (size_t) !(!HeadSize | !TailSize));
   }
+#endif
 
-/* Used by SortSizesDescending */
-static int size_sorter(const void * a, const void * b)
+/*
+ * Used by sort_descending and sort_precedes.  Returns the alignment of
+ * Element: the size_t at AlignOffset into it, unless AlignOffset or that
+ * alignment is zero, in which case it is the factor for the size at offset 0
+ */
+static size_t sort_alignment(const char * Element, size_t AlignOffset)
   {
-    size_t sa;
-    size_t sb;
+    size_t alignment;
 
-    /* The naive test doesn't account for overflow */
-    sa = *(size_t *) a;
-    sb = *(size_t *) b;
-    if (sa < sb)
-      return 1;
-    if (sa > sb)
-      return -1;
-    return 0;
+    alignment = AlignOffset ? *(const size_t *) (Element + AlignOffset) : 0;
+    if (!alignment)
+      alignment = LargestPowerOfTwoFactor(*(const size_t *) Element);
+    return alignment;
+  }
+
+/*
+ * Used by SortAlignmentsDescending and SortSizesDescending.  Sorts the
+ * elements of Array by size or, if ByAlignment is non-zero, by alignment
+ * and then by size.  The keys are sorted with the indices of their
+ * elements, then each element is moved just once.  Elements which are
+ * nothing but a size_t can be rewritten from sorted size keys
+ */
+static void sort_descending(
+    size_t * Array,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  )
+  {
+    char * bytes;
+    size_t i;
+    struct sort_item * items;
+    int need_scratch;
+    char * scratch;
+    struct sort_item * sorted;
+
+    bytes = (char *) Array;
+    if (Count <= DAlignSortInPlace)
+      {
+        swap_sort(bytes, Count, Size, ByAlignment, AlignOffset);
+        return;
+      }
+
+    need_scratch = ByAlignment || Size != sizeof (size_t);
+    items = NULL;
+    scratch = NULL;
+    if (Count <= SIZE_MAX / 2 / sizeof *items && Count <= SIZE_MAX / Size)
+      {
+        items = malloc(2 * Count * sizeof *items);
+        if (need_scratch)
+          scratch = malloc(Count * Size);
+      }
+    if (!items || (need_scratch && !scratch))
+      {
+        free(items);
+        free(scratch);
+        sort_in_place(bytes, Count, Size, ByAlignment, AlignOffset);
+        return;
+      }
+
+    for (i = 0; i < Count; ++i)
+      {
+        items[i].key = *(size_t *) (bytes + i * Size);
+        items[i].index = i;
+      }
+    sorted = radix_sort(items, items + Count, Count);
+
+    /* Being stable, sorting again by alignment keeps sizes as a tie-breaker */
+    if (ByAlignment)
+      {
+        for (i = 0; i < Count; ++i)
+          {
+            sorted[i].key = sort_alignment(
+                bytes + sorted[i].index * Size,
+                AlignOffset
+              );
+          }
+        sorted = radix_sort(
+            sorted,
+            sorted == items ? items + Count : items,
+            Count
+          );
+      }
+
+    if (scratch)
+      {
+        for (i = 0; i < Count; ++i)
+          memcpy(scratch + i * Size, bytes + sorted[i].index * Size, Size);
+        memcpy(Array, scratch, Count * Size);
+      }
+      else
+      {
+        for (i = 0; i < Count; ++i)
+          Array[i] = sorted[i].key;
+      }
+    free(items);
+    free(scratch);
+  }
+
+/*
+ * Used by sort_descending and sort_in_place, if there is not enough memory
+ * for the radix sort.  A stable merge sort which merges in place, by
+ * rotating, so it takes O(n log^2 n) time and logarithmic stack
+ */
+static void sort_in_place(
+    char * Bytes,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  )
+  {
+    size_t left;
+
+    if (Count <= DAlignSortInPlace)
+      {
+        swap_sort(Bytes, Count, Size, ByAlignment, AlignOffset);
+        return;
+      }
+    left = Count / 2;
+    sort_in_place(Bytes, left, Size, ByAlignment, AlignOffset);
+    sort_in_place(
+        Bytes + left * Size,
+        Count - left,
+        Size,
+        ByAlignment,
+        AlignOffset
+      );
+    sort_merge(Bytes, left, Count - left, Size, ByAlignment, AlignOffset);
+  }
+
+/*
+ * Used by sort_in_place.  Merges the sorted runs of Left and then Right
+ * elements at Bytes.  The longer run is split in half, the other where its
+ * middle element would go, and the inner parts are swapped by a rotation,
+ * leaving two smaller merges.  Ties stay in their order
+ */
+static void sort_merge(
+    char * Bytes,
+    size_t Left,
+    size_t Right,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  )
+  {
+    size_t first_cut;
+    size_t high;
+    size_t low;
+    size_t middle;
+    size_t second_cut;
+
+    while (Left && Right)
+      {
+        if (Left + Right == 2)
+          {
+            /* Just one element on each side */
+            if (sort_precedes(Bytes + Size, Bytes, ByAlignment, AlignOffset))
+              sort_rotate(Bytes, 1, 2, Size);
+            return;
+          }
+
+        if (Left > Right)
+          {
+            /* Find the first right element not preceding the cut one */
+            first_cut = Left / 2;
+            low = Left;
+            high = Left + Right;
+            while (low < high)
+              {
+                middle = low + (high - low) / 2;
+                if (sort_precedes(
+                    Bytes + middle * Size,
+                    Bytes + first_cut * Size,
+                    ByAlignment,
+                    AlignOffset
+                  ))
+                  low = middle + 1;
+                  else
+                  high = middle;
+              }
+            second_cut = low;
+          }
+          else
+          {
+            /* Find the first left element which the cut one precedes */
+            second_cut = Left + Right / 2;
+            low = 0;
+            high = Left;
+            while (low < high)
+              {
+                middle = low + (high - low) / 2;
+                if (sort_precedes(
+                    Bytes + second_cut * Size,
+                    Bytes + middle * Size,
+                    ByAlignment,
+                    AlignOffset
+                  ))
+                  high = middle;
+                  else
+                  low = middle + 1;
+              }
+            first_cut = low;
+          }
+
+        sort_rotate(
+            Bytes + first_cut * Size,
+            Left - first_cut,
+            second_cut - first_cut,
+            Size
+          );
+        middle = first_cut + second_cut - Left;
+        sort_merge(
+            Bytes,
+            first_cut,
+            middle - first_cut,
+            Size,
+            ByAlignment,
+            AlignOffset
+          );
+
+        /* Merge what follows without recursing */
+        Bytes += middle * Size;
+        Right = Left + Right - second_cut;
+        Left = second_cut - middle;
+      }
+  }
+
+/*
+ * Used by sort_merge and swap_sort.  Returns non-zero if the element at
+ * Left belongs before the one at Right, by alignment if ByAlignment is
+ * non-zero, and then by size
+ */
+static int sort_precedes(
+    const char * Left,
+    const char * Right,
+    int ByAlignment,
+    size_t AlignOffset
+  )
+  {
+    size_t left;
+    size_t right;
+
+    if (ByAlignment)
+      {
+        left = sort_alignment(Left, AlignOffset);
+        right = sort_alignment(Right, AlignOffset);
+        if (left != right)
+          return left > right;
+      }
+    return *(const size_t *) Left > *(const size_t *) Right;
+  }
+
+/*
+ * Used by sort_merge.  Rotates the Count elements at Bytes so that the
+ * element at Left comes first, by reversing both parts and then the whole,
+ * exchanging elements a byte at a time
+ */
+static void sort_rotate(char * Bytes, size_t Left, size_t Count, size_t Size)
+  {
+    char byte;
+    size_t i;
+    size_t j;
+    size_t k;
+    size_t part;
+    size_t parts[3][2];
+
+    parts[0][0] = 0;
+    parts[0][1] = Left;
+    parts[1][0] = Left;
+    parts[1][1] = Count;
+    parts[2][0] = 0;
+    parts[2][1] = Count;
+    for (part = 0; part < 3; ++part)
+      {
+        i = parts[part][0];
+        j = parts[part][1];
+        for (; i + 1 < j; ++i, --j)
+          {
+            for (k = 0; k < Size; ++k)
+              {
+                byte = Bytes[i * Size + k];
+                Bytes[i * Size + k] = Bytes[(j - 1) * Size + k];
+                Bytes[(j - 1) * Size + k] = byte;
+              }
+          }
+      }
+  }
+
+void SortAlignmentsDescending(
+    size_t * Array,
+    size_t Count,
+    size_t Size,
+    size_t AlignOffset
+  )
+  {
+    /* Nothing to do? */
+    if (!Array || !Count || Size < sizeof (size_t))
+      return;
+    if (AlignOffset && AlignOffset > Size - sizeof (size_t))
+      return;
+    sort_descending(Array, Count, Size, 1, AlignOffset);
   }
 
 void SortSizesDescending(size_t * Array, size_t Count, size_t Size)
@@ -89,56 +664,715 @@ void SortSizesDescending(size_t * Array, size_t Count, size_t Size)
     /* Nothing to do? */
     if (!Array || !Count || Size < sizeof (size_t))
       return;
-    qsort(Array, Count, Size, size_sorter);
+    sort_descending(Array, Count, Size, 0, 0);
   }
 
-size_t TailAlignedSize(size_t HeadSize, size_t TailSize)
+/*
+ * Used by sort_descending and sort_in_place, for arrays of at most
+ * DAlignSortInPlace elements.  A stable insertion sort, by alignment if
+ * ByAlignment is non-zero and then by size, which exchanges adjacent
+ * elements a byte at a time
+ */
+static void swap_sort(
+    char * Bytes,
+    size_t Count,
+    size_t Size,
+    int ByAlignment,
+    size_t AlignOffset
+  )
   {
-    size_t factor;
-    size_t hpow;
-    size_t padding;
-    size_t remainder;
+    char byte;
+    size_t i;
+    size_t j;
+    size_t k;
+    char * left;
+    char * right;
+
+    for (i = 1; i < Count; ++i)
+      {
+        for (j = i; j; --j)
+          {
+            left = Bytes + (j - 1) * Size;
+            right = left + Size;
+            if (!sort_precedes(right, left, ByAlignment, AlignOffset))
+              break;
+            for (k = 0; k < Size; ++k)
+              {
+                byte = left[k];
+                left[k] = right[k];
+                right[k] = byte;
+              }
+          }
+      }
+  }
+
+/*
+ * Used by TailAlignedSize, TailAlignedSizeBatch and tail_layout.  Computes
+ * the total size, given the strictest alignment, Factor, which must be a
+ * power of two
+ */
+static size_t tail_aligned_size(
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Factor,
+    struct tail_layout * Layout
+  )
+  {
+    size_t mask;
+    int overflow;
     size_t sum;
-    size_t tpow;
+    size_t total;
+
+    Layout->alignment = Factor;
+
+    /*
+     * The factor is a power of two, so round up by masking.  If either
+     * addition overflows, the sizes are too large
+     */
+    mask = Factor - 1;
+    overflow = DAddOverflows(&sum, HeadSize, TailSize);
+    overflow |= DAddOverflows(&total, sum, mask);
+    Layout->overflow = overflow;
+    total &= ~mask;
 
-    /* Check for proper parameters */
-    if (!HeadSize || !TailSize)
+    /* Zero for improper parameters or overflow, without branching */
+    return total & ((size_t) 0 - (size_t) !(overflow | !HeadSize | !TailSize));
+  }
+
+#ifdef DAlignAvx2
+/*
+ * Used by TailAlignedSizeBatch.  Computes four results at a time, just as
+ * tail_aligned_size does, and returns how many were computed.  AVX2 only
+ * compares signed 64-bit lanes, so unsigned comparisons flip the sign bits
+ */
+static size_t tail_aligned_size_avx2(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    __m256i bad;
+    __m256i factor;
+    __m256i head;
+    __m256i hpow;
+    size_t i;
+    __m256i limit_bit;
+    __m256i limit_fix;
+    __m256i mask;
+    __m256i one;
+    __m256i sign;
+    __m256i sum;
+    __m256i tail;
+    __m256i total;
+    __m256i tpow;
+    __m256i zero;
+
+    zero = _mm256_setzero_si256();
+    one = _mm256_set1_epi64x(1);
+    sign = _mm256_slli_epi64(one, 63);
+    /* A lowest set bit above DMaxPowerOfTwoFactor can only be the top bit */
+    limit_bit = sign;
+    limit_fix = _mm256_xor_si256(sign, _mm256_srli_epi64(sign, 1));
+    for (i = 0; i + 4 <= Count; i += 4)
+      {
+        head = _mm256_loadu_si256((const __m256i *) (Heads + i));
+        tail = _mm256_loadu_si256((const __m256i *) (Tails + i));
+
+        /* Determine largest power-of-two factor for head */
+        hpow = _mm256_and_si256(head, _mm256_sub_epi64(zero, head));
+        hpow = _mm256_xor_si256(
+            hpow,
+            _mm256_and_si256(_mm256_cmpeq_epi64(hpow, limit_bit), limit_fix)
+          );
+        bad = _mm256_cmpeq_epi64(head, zero);
+        hpow = _mm256_or_si256(hpow, _mm256_and_si256(bad, one));
+
+        /* Determine largest power-of-two factor for tail */
+        tpow = _mm256_and_si256(tail, _mm256_sub_epi64(zero, tail));
+        tpow = _mm256_xor_si256(
+            tpow,
+            _mm256_and_si256(_mm256_cmpeq_epi64(tpow, limit_bit), limit_fix)
+          );
+        mask = _mm256_cmpeq_epi64(tail, zero);
+        tpow = _mm256_or_si256(tpow, _mm256_and_si256(mask, one));
+        bad = _mm256_or_si256(bad, mask);
+
+        /* Choose the strictest alignment; both are positive when signed */
+        factor = _mm256_blendv_epi8(
+            tpow,
+            hpow,
+            _mm256_cmpgt_epi64(hpow, tpow)
+          );
+
+        /* Round up by masking, noting either addition overflowing */
+        mask = _mm256_sub_epi64(factor, one);
+        sum = _mm256_add_epi64(head, tail);
+        bad = _mm256_or_si256(
+            bad,
+            _mm256_cmpgt_epi64(
+                _mm256_xor_si256(head, sign),
+                _mm256_xor_si256(sum, sign)
+              )
+          );
+        total = _mm256_add_epi64(sum, mask);
+        bad = _mm256_or_si256(
+            bad,
+            _mm256_cmpgt_epi64(
+                _mm256_xor_si256(sum, sign),
+                _mm256_xor_si256(total, sign)
+              )
+          );
+        total = _mm256_andnot_si256(mask, total);
+
+        /* Zero for improper parameters or overflow */
+        total = _mm256_andnot_si256(bad, total);
+        _mm256_storeu_si256((__m256i *) (Out + i), total);
+      }
+    return i;
+  }
+
+static size_t tail_aligned_size32_avx2(
+    const uint32_t * Heads,
+    const uint32_t * Tails,
+    uint32_t * Out,
+    size_t Count
+  )
+  {
+    __m256i bad;
+    __m256i factor;
+    __m256i head;
+    __m256i hpow;
+    size_t i;
+    __m256i limit_bit;
+    __m256i limit_fix;
+    __m256i mask;
+    __m256i one;
+    __m256i ones;
+    __m256i sum;
+    __m256i tail;
+    __m256i total;
+    __m256i tpow;
+    __m256i zero;
+
+    zero = _mm256_setzero_si256();
+    one = _mm256_set1_epi32(1);
+    ones = _mm256_cmpeq_epi32(zero, zero);
+    /* A lowest set bit above DMaxPowerOfTwoFactor32 is the top bit */
+    limit_bit = _mm256_slli_epi32(one, 31);
+    limit_fix = _mm256_xor_si256(limit_bit, _mm256_srli_epi32(limit_bit, 1));
+    for (i = 0; i + 8 <= Count; i += 8)
+      {
+        head = _mm256_loadu_si256((const __m256i *) (Heads + i));
+        tail = _mm256_loadu_si256((const __m256i *) (Tails + i));
+
+        /* Determine largest power-of-two factor for head */
+        hpow = _mm256_and_si256(head, _mm256_sub_epi32(zero, head));
+        hpow = _mm256_xor_si256(
+            hpow,
+            _mm256_and_si256(_mm256_cmpeq_epi32(hpow, limit_bit), limit_fix)
+          );
+        bad = _mm256_cmpeq_epi32(head, zero);
+        hpow = _mm256_or_si256(hpow, _mm256_and_si256(bad, one));
+
+        /* Determine largest power-of-two factor for tail */
+        tpow = _mm256_and_si256(tail, _mm256_sub_epi32(zero, tail));
+        tpow = _mm256_xor_si256(
+            tpow,
+            _mm256_and_si256(_mm256_cmpeq_epi32(tpow, limit_bit), limit_fix)
+          );
+        mask = _mm256_cmpeq_epi32(tail, zero);
+        tpow = _mm256_or_si256(tpow, _mm256_and_si256(mask, one));
+        bad = _mm256_or_si256(bad, mask);
+
+        /* Choose the strictest alignment, as there is an unsigned maximum */
+        factor = _mm256_max_epu32(hpow, tpow);
+
+        /*
+         * Round up by masking, noting either addition overflowing: an
+         * overflowed sum is less than what was added to, so is not the
+         * maximum of the two
+         */
+        mask = _mm256_sub_epi32(factor, one);
+        sum = _mm256_add_epi32(head, tail);
+        bad = _mm256_or_si256(
+            bad,
+            _mm256_xor_si256(
+                _mm256_cmpeq_epi32(_mm256_max_epu32(head, sum), sum),
+                ones
+              )
+          );
+        total = _mm256_add_epi32(sum, mask);
+        bad = _mm256_or_si256(
+            bad,
+            _mm256_xor_si256(
+                _mm256_cmpeq_epi32(_mm256_max_epu32(sum, total), total),
+                ones
+              )
+          );
+        total = _mm256_andnot_si256(mask, total);
+
+        /* Zero for improper parameters or overflow */
+        total = _mm256_andnot_si256(bad, total);
+        _mm256_storeu_si256((__m256i *) (Out + i), total);
+      }
+    return i;
+  }
+#endif
+
+size_t TailAlignedSize(size_t HeadSize, size_t TailSize)
+  {
+    struct tail_layout layout;
+
+#ifdef DAlignSmallTable
+    if ((HeadSize | TailSize) < DAlignSmallLimit)
+      return small_tail_aligned_size(HeadSize, TailSize);
+#endif
+    return tail_aligned_size(
+        HeadSize,
+        TailSize,
+        DTailAlignedFactor(HeadSize, TailSize),
+        &layout
+      );
+  }
+
+uint32_t TailAlignedSize32(uint32_t HeadSize, uint32_t TailSize)
+  {
+    uint32_t head_factor;
+    uint32_t mask;
+    uint32_t sum;
+    uint32_t tail_factor;
+    uint32_t total;
+
+    head_factor = LargestPowerOfTwoFactor32(HeadSize);
+    tail_factor = LargestPowerOfTwoFactor32(TailSize);
+    mask = (head_factor > tail_factor ? head_factor : tail_factor) - 1;
+
+    /* If either addition wraps, the sizes are too large */
+    sum = HeadSize + TailSize;
+    total = sum + mask;
+    if (!HeadSize || !TailSize || sum < HeadSize || total < sum)
       return 0;
+    return total & ~mask;
+  }
 
-    /* Determine largest power-of-two factor for head */
-    hpow = LargestPowerOfTwoFactor(HeadSize);
+void TailAlignedSizeBatch(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+    struct tail_layout layout;
 
-    /* Determine largest power-of-two factor for tail */
-    tpow = LargestPowerOfTwoFactor(TailSize);
+    /* Nothing to do? */
+    if (!Heads || !Tails || !Out)
+      return;
 
-    /* Choose the strictest alignment */
-    if (hpow > tpow)
-      factor = hpow;
-      else
-      factor = tpow;
+    i = 0;
+#ifdef DAlignAvx2
+    if (__builtin_cpu_supports("avx2"))
+      i = tail_aligned_size_avx2(Heads, Tails, Out, Count);
+#endif
+
+    /* Whatever remains, one at a time */
+    for (; i < Count; ++i)
+      {
+        Out[i] = tail_aligned_size(
+            Heads[i],
+            Tails[i],
+            DTailAlignedFactor(Heads[i], Tails[i]),
+            &layout
+          );
+      }
+  }
+
+void TailAlignedSizeBatch32(
+    const uint32_t * Heads,
+    const uint32_t * Tails,
+    uint32_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
 
-    /* Check for overflow */
-    if (SIZE_MAX - HeadSize < TailSize)
+    /* Nothing to do? */
+    if (!Heads || !Tails || !Out)
+      return;
+
+    i = 0;
+#ifdef DAlignAvx2
+    if (__builtin_cpu_supports("avx2"))
+      i = tail_aligned_size32_avx2(Heads, Tails, Out, Count);
+#endif
+
+    /* Whatever remains, one at a time */
+    for (; i < Count; ++i)
+      Out[i] = TailAlignedSize32(Heads[i], Tails[i]);
+  }
+
+size_t TailAlignedSizeEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    struct tail_layout layout;
+
+    return TailLayoutEx(&layout, HeadSize, HeadAlign, TailSize, TailAlign);
+  }
+
+size_t TailAlignedSizeMulti(
+    const size_t * Sizes,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Offsets,
+    int Flags
+  )
+  {
+    size_t align;
+    size_t alignment;
+    size_t end;
+    size_t i;
+    size_t mask;
+
+    if (!Sizes || !Offsets || !Count)
       return 0;
 
-    /* Tentative, optimistic result */
-    sum = HeadSize + TailSize;
+    alignment = 1;
+    end = 0;
+    for (i = 0; i < Count; ++i)
+      {
+        align = explicit_alignment(Sizes[i], Aligns ? Aligns[i] : 0);
+        if (!Sizes[i] || !align)
+          return 0;
+        mask = align - 1;
+        if (end > (SIZE_MAX & ~mask))
+          return 0;
+        Offsets[i] = (end + mask) & ~mask;
+        if (Sizes[i] > SIZE_MAX - Offsets[i])
+          return 0;
+        end = Offsets[i] + Sizes[i];
+        if (align > alignment)
+          alignment = align;
+      }
 
-    /* Avoid unexpected problems */
-    remainder = sum % factor;
-    if (remainder)
+    mask = alignment - 1;
+    if (end > (SIZE_MAX & ~mask))
+      return 0;
+    end = (end + mask) & ~mask;
+
+    /*
+     * The end is a multiple of the last object's alignment, still in align,
+     * so the object can only be aligned against it if its size is, too
+     */
+    if (Flags & DAlignMultiTail)
       {
-        padding = factor - remainder;
-        /* Check for overflow */
-        if (SIZE_MAX - sum < padding)
+        if (Sizes[Count - 1] & (align - 1))
           return 0;
-        sum += padding;
+        Offsets[Count - 1] = end - Sizes[Count - 1];
+      }
+    return end;
+  }
+
+size_t TailAlignedStride(
+    size_t HeadSize,
+    size_t TailSize,
+    size_t StrideAlign
+  )
+  {
+    size_t mask;
+    size_t stride;
+
+    stride = TailAlignedSize(HeadSize, TailSize);
+    if (!stride || StrideAlign & (StrideAlign - 1))
+      return 0;
+    if (!StrideAlign)
+      return stride;
+
+    mask = StrideAlign - 1;
+    if (stride > (SIZE_MAX & ~mask))
+      return 0;
+    return (stride + mask) & ~mask;
+  }
+
+/*
+ * Used by the TailArray functions.  Returns the offset of the elements, and
+ * stores the strictest alignment into *Factor, or returns zero if any of
+ * the parameters would make TailArraySize return zero for every count
+ */
+static size_t tail_array(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign,
+    size_t * Factor
+  )
+  {
+    size_t mask;
+
+    HeadAlign = explicit_alignment(HeadSize, HeadAlign);
+    ElementAlign = explicit_alignment(ElementSize, ElementAlign);
+    if (!HeadSize ||
+      !ElementSize ||
+      !HeadAlign ||
+      !ElementAlign ||
+      ElementSize & (ElementAlign - 1))
+      return 0;
+    *Factor = HeadAlign > ElementAlign ? HeadAlign : ElementAlign;
+
+    mask = ElementAlign - 1;
+    if (HeadSize > (SIZE_MAX & ~mask))
+      return 0;
+    return (HeadSize + mask) & ~mask;
+  }
+
+size_t TailArrayCapacity(
+    size_t TotalSize,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign
+  )
+  {
+    size_t factor;
+    size_t offset;
+
+    offset = tail_array(
+        HeadSize,
+        HeadAlign,
+        ElementSize,
+        ElementAlign,
+        &factor
+      );
+    if (!offset || TotalSize < offset)
+      return 0;
+    return (TotalSize - offset) / ElementSize;
+  }
+
+size_t TailArrayOffset(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign
+  )
+  {
+    size_t factor;
+
+    return tail_array(HeadSize, HeadAlign, ElementSize, ElementAlign, &factor);
+  }
+
+size_t TailArraySize(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign,
+    size_t Count,
+    size_t RoundTo
+  )
+  {
+    size_t factor;
+    size_t mask;
+    size_t offset;
+
+    offset = tail_array(
+        HeadSize,
+        HeadAlign,
+        ElementSize,
+        ElementAlign,
+        &factor
+      );
+    if (!offset ||
+      RoundTo & (RoundTo - 1) ||
+      Count > (SIZE_MAX - offset) / ElementSize)
+      return 0;
+    offset += Count * ElementSize;
+
+    /* Rounded up as TailAlignedSize would */
+    if (RoundTo > factor)
+      factor = RoundTo;
+    mask = factor - 1;
+    if (offset > (SIZE_MAX & ~mask))
+      return 0;
+    return (offset + mask) & ~mask;
+  }
+
+void * TailFromHead(void * Head, const struct tail_layout * Layout)
+  {
+    return (char *) Head + Layout->tail_offset;
+  }
+
+/*
+ * Used by TailLayout and TailLayoutEx.  Fills Layout, given the strictest
+ * alignment, Factor, which must be a power of two
+ */
+static size_t tail_layout(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Factor
+  )
+  {
+    size_t total_size;
+
+    total_size = tail_aligned_size(HeadSize, TailSize, Factor, Layout);
+    Layout->total_size = total_size;
+    if (!total_size)
+      {
+        Layout->padding = SIZE_MAX;
+        Layout->tail_offset = 0;
+        return 0;
+      }
+    Layout->tail_offset = TailOffset(total_size, TailSize);
+    Layout->padding = Layout->tail_offset - HeadSize;
+    return total_size;
+  }
+
+size_t TailLayout(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t TailSize
+  )
+  {
+    if (!Layout)
+      return 0;
+    return tail_layout(
+        Layout,
+        HeadSize,
+        TailSize,
+        DTailAlignedFactor(HeadSize, TailSize)
+      );
+  }
+
+uint32_t TailLayout32(
+    struct tail_layout32 * Layout,
+    uint32_t HeadSize,
+    uint32_t TailSize
+  )
+  {
+    uint32_t total_size;
+
+    if (!Layout)
+      return 0;
+    total_size = TailAlignedSize32(HeadSize, TailSize);
+    Layout->head_size = HeadSize;
+    Layout->tail_size = TailSize;
+    Layout->tail_offset = total_size ? total_size - TailSize : 0;
+    Layout->total_size = total_size;
+    return total_size;
+  }
+
+void * TailLayoutAlloc(const struct tail_layout * Layout, void ** Tail)
+  {
+    char * head;
+
+    head = Layout->total_size ? malloc(Layout->total_size) : NULL;
+    if (Tail)
+      *Tail = head ? head + Layout->tail_offset : NULL;
+    return head;
+  }
+
+size_t TailLayoutEx(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    size_t head_align;
+    size_t tail_align;
+
+    if (!Layout)
+      return 0;
+
+    head_align = explicit_alignment(HeadSize, HeadAlign);
+    tail_align = explicit_alignment(TailSize, TailAlign);
+
+    /* The tail could not be aligned if its size were not a multiple */
+    if (!head_align || !tail_align || TailSize & (tail_align - 1))
+      {
+        Layout->alignment = 0;
+        Layout->overflow = 0;
+        Layout->padding = SIZE_MAX;
+        Layout->tail_offset = 0;
+        Layout->total_size = 0;
+        return 0;
+      }
+
+    return tail_layout(
+        Layout,
+        HeadSize,
+        TailSize,
+        head_align > tail_align ? head_align : tail_align
+      );
+  }
+
+size_t TailLayoutRounded(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    size_t RoundTo
+  )
+  {
+    size_t extra;
+    size_t mask;
+    size_t total_size;
+
+    total_size = TailLayoutEx(
+        Layout,
+        HeadSize,
+        HeadAlign,
+        TailSize,
+        TailAlign
+      );
+    if (!total_size || !RoundTo)
+      return total_size;
+
+    mask = RoundTo - 1;
+    if (RoundTo & mask || total_size > (SIZE_MAX & ~mask))
+      {
+        /* As for an alignment which is not a power of two, or an overflow */
+        if (RoundTo & mask)
+          Layout->alignment = 0;
+        Layout->overflow = !(RoundTo & mask);
+        Layout->padding = SIZE_MAX;
+        Layout->tail_offset = 0;
+        Layout->total_size = 0;
+        return 0;
       }
 
-    return sum;
+    /* The tail stays at the end, which is now a multiple of RoundTo */
+    extra = ((total_size + mask) & ~mask) - total_size;
+    Layout->padding += extra;
+    Layout->tail_offset += extra;
+    Layout->total_size += extra;
+    return Layout->total_size;
   }
 
 size_t TailOffset(size_t TotalSize, size_t TailSize)
+  {
+    return DTailOffset(TotalSize, TailSize);
+  }
+
+uint32_t TailOffset32(uint32_t TotalSize, uint32_t TailSize)
   {
     return TotalSize - TailSize;
   }
+
+size_t TailOffsetEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    struct tail_layout layout;
+
+    TailLayoutEx(&layout, HeadSize, HeadAlign, TailSize, TailAlign);
+    return layout.tail_offset;
+  }
@@ -40,8 +40,115 @@
 #ifndef DIncluded_align
 #define DIncluded_align 1
 #include <stddef.h>
+/* C >= C99 required for uint32_t */
+#include <stdint.h>
+/*
+ * The largest factor reported by LargestPowerOfTwoFactor: the largest
+ * power of two which can be doubled without overflowing a size_t
+ */
+#define DMaxPowerOfTwoFactor (((size_t) -1) / 4 + 1)
+/* Isolate the lowest set bit of Number, or zero if Number is zero */
+#define DLowestSetBit(Number) ((size_t) (Number) & (~(size_t) (Number) + 1))
+/*
+ * Same result as the LargestPowerOfTwoFactor function, but a constant
+ * expression if Number is one.  Number is evaluated more than once.
+ * Zero has no set bit, so the factor for zero is made 1 by OR-ing
+ */
+#define DLargestPowerOfTwoFactor(Number) \
+  (DLowestSetBit(Number) > DMaxPowerOfTwoFactor ? \
+    DMaxPowerOfTwoFactor : \
+    DLowestSetBit(Number) | (size_t) !(Number))
+/* The strictest of the alignments inferred for HeadSize and TailSize */
+#define DTailAlignedFactor(HeadSize, TailSize) \
+  (DLargestPowerOfTwoFactor(HeadSize) > DLargestPowerOfTwoFactor(TailSize) ? \
+    DLargestPowerOfTwoFactor(HeadSize) : \
+    DLargestPowerOfTwoFactor(TailSize))
+/*
+ * Same result as the TailAlignedSize function, including zero for zero
+ * sizes or overflow, but a constant expression if both arguments are.
+ * They are evaluated more than once.  The sum is rounded up by masking,
+ * which cannot overflow once it is known to be no more than the largest
+ * multiple of the factor
+ */
+#define DTailAlignedSize(HeadSize, TailSize) \
+  (!(HeadSize) || !(TailSize) || \
+    (size_t) -1 - (size_t) (HeadSize) < (size_t) (TailSize) || \
+    (size_t) (HeadSize) + (size_t) (TailSize) > \
+      ((size_t) -1 & ~(DTailAlignedFactor(HeadSize, TailSize) - 1)) ? \
+    (size_t) 0 : \
+    ((size_t) (HeadSize) + (size_t) (TailSize) + \
+      (DTailAlignedFactor(HeadSize, TailSize) - 1)) & \
+      ~(DTailAlignedFactor(HeadSize, TailSize) - 1))
+/* Same result as the TailOffset function, but a constant expression */
+#define DTailOffset(TotalSize, TailSize) \
+  ((size_t) (TotalSize) - (size_t) (TailSize))
+/* Sizes to round up to, for TailLayoutRounded and TailArraySize */
+#define DAlignPageSize ((size_t) 4096)
+#define DAlignHugePageSize ((size_t) 2 * 1024 * 1024)
+/* The cache-line size assumed for keeping apart data written by threads */
+#define DAlignCacheLine 64
+/* Flags for TailAlignedSizeMulti */
+#define DAlignMultiTail 1
+/* The largest factor reported by LargestPowerOfTwoFactor32 */
+#define DMaxPowerOfTwoFactor32 ((uint32_t) 1 << 30)
+
+/* Describes the storage for a head and a tail, as filled by TailLayout */
+struct tail_layout
+  {
+    /* The strictest alignment inferred for the head and the tail */
+    size_t alignment;
+    /* Non-zero if the sizes were too large */
+    int overflow;
+    /* Bytes of padding between the head and the tail */
+    size_t padding;
+    /* Offset of the tail into the total size */
+    size_t tail_offset;
+    /* The result of TailAlignedSize */
+    size_t total_size;
+  };
+
+/*
+ * A compact description of the storage for a head and a tail, as filled by
+ * TailLayout32, for tables of many of them: 16 bytes instead of the 40 of
+ * a struct tail_layout on a 64-bit platform.  The padding is the tail
+ * offset less the head size
+ */
+struct tail_layout32
+  {
+    uint32_t head_size;
+    uint32_t tail_size;
+    /* Offset of the tail into the total size */
+    uint32_t tail_offset;
+    /* The result of TailAlignedSize32 */
+    uint32_t total_size;
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * Allocates storage for a head and a tail, sized by TailAlignedSize, and
+ * returns a pointer to the head.  If Tail is non-null, a pointer to the tail
+ * is stored there.  If TailAlignedSize would return zero or the allocation
+ * fails, this function returns a null pointer and stores a null pointer into
+ * Tail.  The storage is released with FreeHeadTail
+ */
+extern void * AllocHeadTail(size_t HeadSize, size_t TailSize, void ** Tail);
+/*
+ * Releases storage returned by AllocHeadTail or TailLayoutAlloc.  Head may
+ * be null
+ */
+extern void FreeHeadTail(void * Head);
+/*
+ * Returns a pointer to the head, given a pointer to the tail and the
+ * layout from TailLayout for the same sizes
+ */
+extern void * HeadFromTail(void * Tail, const struct tail_layout * Layout);
 /* Determine largest power-of-two factor for Number */
 extern size_t LargestPowerOfTwoFactor(size_t Number);
+/* As LargestPowerOfTwoFactor, up to DMaxPowerOfTwoFactor32 */
+extern uint32_t LargestPowerOfTwoFactor32(uint32_t Number);
 /*
  * Returns the size of any padding that would be introduced by the
  * TailAlignedSize function.  If the arguments would result in the
@@ -49,13 +156,44 @@ extern size_t LargestPowerOfTwoFactor(size_t Number);
  * SIZE_MAX
  */
 extern size_t PaddingSize(size_t HeadSize, size_t TailSize);
+/*
+ * As PaddingSize, for the result of TailAlignedSize32, or UINT32_MAX if
+ * that is zero
+ */
+extern uint32_t PaddingSize32(uint32_t HeadSize, uint32_t TailSize);
+/* As PaddingSize, but with the alignments of TailAlignedSizeEx */
+extern size_t PaddingSizeEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+/*
+ * Sort an array of elements into descending order of alignment, and then
+ * of size, just as SortSizesDescending does.  If AlignOffset is non-zero,
+ * the alignment of each element is a size_t at AlignOffset into that
+ * element, such as one holding an alignof result.  If AlignOffset is zero
+ * or that alignment is zero, the element's alignment is taken to be the
+ * LargestPowerOfTwoFactor of its size.  If AlignOffset is non-zero and a
+ * size_t would not fit at AlignOffset into Size bytes, this function
+ * simply returns without modifying anything
+ */
+extern void SortAlignmentsDescending(
+    size_t * Array,
+    size_t Count,
+    size_t Size,
+    size_t AlignOffset
+  );
 /*
  * Sort an array of elements into descending order.  The Array consists
  * of Count elements, each having Size bytes.  For each element, a size_t is
  * expected to be at offset 0 into that element.  It is the value of this
  * size_t object which determines the final ordering.  If Array is null or
  * Count is zero or Size < the size of a size_t, this function simply
- * returns without modifying anything
+ * returns without modifying anything.  The sort is stable.  It takes
+ * linear time, except that up to 32 elements are sorted in place without
+ * allocating, and that if there is not enough memory, the elements are
+ * merge-sorted in place, in O(n log^2 n) time
  */
 extern void SortSizesDescending(size_t * Array, size_t Count, size_t Size);
 /*
@@ -67,6 +205,238 @@ extern void SortSizesDescending(size_t * Array, size_t Count, size_t Size);
  * Padding, if any, will begin at HeadSize bytes into the total size
  */
 extern size_t TailAlignedSize(size_t HeadSize, size_t TailSize);
+/*
+ * As TailAlignedSize, but for sizes which are uint32_t, with zero for a
+ * total size which would exceed UINT32_MAX.  The factors are those of
+ * LargestPowerOfTwoFactor32, which stop at 2^30 rather than at
+ * DMaxPowerOfTwoFactor, so the results are the same as those of
+ * TailAlignedSize, wherever they fit, when the factors of both sizes are
+ * no more than 2^30
+ */
+extern uint32_t TailAlignedSize32(uint32_t HeadSize, uint32_t TailSize);
+/*
+ * For each of Count pairs of sizes, stores the result of TailAlignedSize
+ * for Heads[i] and Tails[i] into Out[i], using vector instructions where
+ * the processor has them.  Out may be the same as Heads or Tails, but must
+ * not otherwise overlap them.  If any pointer is null, this function
+ * simply returns without modifying anything
+ */
+extern void TailAlignedSizeBatch(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+/*
+ * As TailAlignedSizeBatch, with the results of TailAlignedSize32, and
+ * twice as many sizes to a vector
+ */
+extern void TailAlignedSizeBatch32(
+    const uint32_t * Heads,
+    const uint32_t * Tails,
+    uint32_t * Out,
+    size_t Count
+  );
+/*
+ * As TailAlignedSize, but with the actual alignments of the head and the
+ * tail, such as alignof results, instead of inferring them from the sizes.
+ * If either alignment is zero, the LargestPowerOfTwoFactor of that size is
+ * used, as TailAlignedSize would.  If either alignment is not a power of
+ * two, or TailSize is not a multiple of TailAlign, this function returns
+ * zero
+ */
+extern size_t TailAlignedSizeEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+/*
+ * Lays out Count objects in one block of storage, such as several opaque
+ * objects whose sizes are only known at run time.  As for the members of a
+ * structure, the objects are placed in the order given, each at the lowest
+ * offset after the end of the one before it which is a multiple of its
+ * alignment, and the total size is the end of the last object rounded up
+ * to a multiple of the strictest alignment.  If Flags includes
+ * DAlignMultiTail, only the last object is then moved, so that its final
+ * byte is the final byte of the total size, as a tail's is; the total size
+ * is the same.  If Aligns is null, or an alignment is zero, the
+ * LargestPowerOfTwoFactor of that size is used.  The offset of each object
+ * is stored into Offsets.  The padding depends on the order of the objects,
+ * and LayoutMembers can find an order with the least.
+ *   Returns the total size, or zero if Sizes or Offsets is null, Count is
+ * zero, a size is zero, an alignment is not a power of two, the total size
+ * would exceed SIZE_MAX, or Flags includes DAlignMultiTail and the size of
+ * the last object is not a multiple of its alignment
+ */
+extern size_t TailAlignedSizeMulti(
+    const size_t * Sizes,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Offsets,
+    int Flags
+  );
+/*
+ * Returns the distance between consecutive head and tail records in an
+ * array, such that the head and the tail of every record are as aligned as
+ * those of the first.  That is the result of TailAlignedSize, which is a
+ * multiple of the strictest alignment inferred for the head and the tail.
+ * If StrideAlign is non-zero, the stride is also rounded up to a multiple
+ * of it, such as a cache-line size, so that records do not share lines.
+ * Returns zero if TailAlignedSize would return zero, StrideAlign is neither
+ * zero nor a power of two, or the stride would be too large
+ */
+extern size_t TailAlignedStride(
+    size_t HeadSize,
+    size_t TailSize,
+    size_t StrideAlign
+  );
+/*
+ * Returns how many elements storage of TotalSize bytes has room for, after
+ * a head, as laid out by TailArraySize.  This can be more than the count
+ * the storage was sized for, because of the rounding up, and such elements
+ * can be used without moving anything.  Returns zero if TailArraySize would
+ * return zero for every count, or TotalSize is less than TailArrayOffset
+ */
+extern size_t TailArrayCapacity(
+    size_t TotalSize,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign
+  );
+/*
+ * Returns the offset of the first element after a head, as laid out by
+ * TailArraySize, which does not depend on the count.  Returns zero if
+ * TailArraySize would return zero for every count
+ */
+extern size_t TailArrayOffset(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign
+  );
+/*
+ * Returns the total size required for a head followed by an array of Count
+ * elements, such as a flexible array member.  Unlike the tail of
+ * TailAlignedSize, the array begins at the lowest offset after the head
+ * satisfying the element alignment, so that it does not move as Count
+ * changes and storage can grow in place.  The total size is rounded up to
+ * the strictest alignment, as by TailAlignedSize, or to RoundTo if that is
+ * greater, such as DAlignPageSize or DAlignHugePageSize, and the elements
+ * that the rounding makes room for are reported by TailArrayCapacity.  The
+ * alignments are as for TailAlignedSizeEx.  Count may be zero.
+ *   Returns zero if either size is zero, either alignment or RoundTo is
+ * neither zero nor a power of two, ElementSize is not a multiple of
+ * ElementAlign, or the total size would be too large
+ */
+extern size_t TailArraySize(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t ElementSize,
+    size_t ElementAlign,
+    size_t Count,
+    size_t RoundTo
+  );
+/*
+ * Returns a pointer to the tail, given a pointer to the head and the
+ * layout from TailLayout for the same sizes
+ */
+extern void * TailFromHead(void * Head, const struct tail_layout * Layout);
+/*
+ * Fills Layout with everything known about the head and tail storage, all
+ * from a single computation, and returns the total size, as the
+ * TailAlignedSize function would.  If that total size is zero, the tail
+ * offset is also zero and the padding is SIZE_MAX, as the PaddingSize
+ * function would return.  If Layout is null, this function returns zero
+ */
+extern size_t TailLayout(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t TailSize
+  );
+/*
+ * As TailLayout, but fills the compact Layout and returns the result of
+ * TailAlignedSize32.  If that is zero, so is the tail offset.  If Layout is
+ * null, this function returns zero
+ */
+extern uint32_t TailLayout32(
+    struct tail_layout32 * Layout,
+    uint32_t HeadSize,
+    uint32_t TailSize
+  );
+/*
+ * As AllocHeadTail, but for a layout already filled by TailLayout or one of
+ * its variants, so that it need not be computed again.  If the total size
+ * of Layout is zero or the allocation fails, this function returns a null
+ * pointer and stores a null pointer into Tail.  The storage is released
+ * with FreeHeadTail
+ */
+extern void * TailLayoutAlloc(const struct tail_layout * Layout, void ** Tail);
+/*
+ * As TailLayout, but with the alignments of TailAlignedSizeEx.  If
+ * TailAlignedSizeEx would return zero because of an alignment, the
+ * alignment and overflow members of Layout are also zero
+ */
+extern size_t TailLayoutEx(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+/*
+ * As TailLayoutEx, but with the total size rounded up to a multiple of
+ * RoundTo, such as DAlignPageSize or DAlignHugePageSize for a large record
+ * with storage of its own pages.  The tail stays at the end, so that it
+ * crosses no more multiples of RoundTo than its size makes it, and the head
+ * stays at the beginning.  If RoundTo is zero, this is just TailLayoutEx.
+ * If RoundTo is not a power of two, the result is as for an alignment that
+ * is not, and if rounding up would overflow, as for sizes too large
+ */
+extern size_t TailLayoutRounded(
+    struct tail_layout * Layout,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    size_t RoundTo
+  );
 extern size_t TailOffset(size_t TotalSize, size_t TailSize);
+extern uint32_t TailOffset32(uint32_t TotalSize, uint32_t TailSize);
+/*
+ * Returns the offset of the tail, with the alignments of TailAlignedSizeEx,
+ * or zero if TailAlignedSizeEx would return zero
+ */
+extern size_t TailOffsetEx(
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+#ifdef __cplusplus
+  }
+#endif
+
+#if defined(__cplusplus) && __cplusplus >= 201103L
+/* Compile-time forms of the functions above, for C++ */
+namespace Align
+  {
+    constexpr size_t LargestPowerOfTwoFactor(size_t Number)
+      {
+        return DLargestPowerOfTwoFactor(Number);
+      }
+
+    constexpr size_t TailAlignedSize(size_t HeadSize, size_t TailSize)
+      {
+        return DTailAlignedSize(HeadSize, TailSize);
+      }
+
+    constexpr size_t TailOffset(size_t TotalSize, size_t TailSize)
+      {
+        return DTailOffset(TotalSize, TailSize);
+      }
+  }
+#endif
 
 #endif /* DIncluded_align */
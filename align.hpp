@@ -0,0 +1,558 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_align_hpp
+#define DIncluded_align_hpp 1
+#if !defined(__cplusplus) || __cplusplus < 201402L
+#error align.hpp requires C++14
+#endif
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "align.h"
+
+namespace Align
+  {
+    namespace Detail
+      {
+        /* The layout of a packed_tuple, computed at compile-time */
+        template <std::size_t Count>
+          struct packed_layout
+            {
+              /* The offset of each member, by original index */
+              std::size_t offsets[Count];
+              /* The original index of each member, in order of offset */
+              std::size_t order[Count];
+              /* The size of the storage, a multiple of the alignment */
+              std::size_t size;
+            };
+
+        /*
+         * Orders the members by descending alignment, then by descending
+         * size, then by original index, just as SortAlignmentsDescending
+         * does.  Each member's size is a multiple of its alignment, so no
+         * padding is needed between them, and only the end might need any
+         */
+        template <class... Types>
+          constexpr packed_layout<sizeof...(Types)> MakePackedLayout()
+            {
+              const std::size_t aligns[] = { alignof(Types)... };
+              const std::size_t sizes[] = { sizeof(Types)... };
+              std::size_t alignment = 1;
+              std::size_t i = 0;
+              std::size_t j = 0;
+              std::size_t k = 0;
+              packed_layout<sizeof...(Types)> layout{};
+              std::size_t offset = 0;
+
+              /* An insertion sort is stable, and simple enough here */
+              for (i = 0; i < sizeof...(Types); ++i)
+                {
+                  for (j = i; j > 0; --j)
+                    {
+                      k = layout.order[j - 1];
+                      if (aligns[k] > aligns[i] ||
+                        (aligns[k] == aligns[i] && sizes[k] >= sizes[i]))
+                        break;
+                      layout.order[j] = k;
+                    }
+                  layout.order[j] = i;
+                }
+
+              for (i = 0; i < sizeof...(Types); ++i)
+                {
+                  k = layout.order[i];
+                  offset = (offset + aligns[k] - 1) & ~(aligns[k] - 1);
+                  layout.offsets[k] = offset;
+                  offset += sizes[k];
+                  if (aligns[k] > alignment)
+                    alignment = aligns[k];
+                }
+              layout.size = (offset + alignment - 1) & ~(alignment - 1);
+              return layout;
+            }
+
+        /* True if all of Values are */
+        template <bool... Values>
+          struct all_of : std::true_type
+            {
+            };
+
+        template <bool Value, bool... Values>
+          struct all_of<Value, Values...> :
+            std::integral_constant<bool, Value && all_of<Values...>::value>
+            {
+            };
+
+        /* True if any of Types is an array */
+        template <class... Types>
+          struct any_array : std::false_type
+            {
+            };
+
+        template <class Type, class... Types>
+          struct any_array<Type, Types...> :
+            std::integral_constant<
+                bool,
+                std::is_array<Type>::value || any_array<Types...>::value
+              >
+            {
+            };
+
+        /* False for a lone argument which is the tuple itself, to copy */
+        template <class Tuple, class... Args>
+          struct not_self : std::true_type
+            {
+            };
+
+        template <class Tuple, class Arg>
+          struct not_self<Tuple, Arg> :
+            std::integral_constant<
+                bool,
+                !std::is_same<typename std::decay<Arg>::type, Tuple>::value
+              >
+            {
+            };
+      }
+
+    /*
+     * Like a std::tuple of Types, but with the members stored in descending
+     * order of alignment, so that there is no padding which could have been
+     * avoided, whatever order the types are given in.  Members are still
+     * accessed by their original index, with get.  The size and the offsets
+     * are constant expressions, so there is no cost at run-time
+     */
+    template <class... Types>
+      class packed_tuple
+        {
+          static_assert(sizeof...(Types) > 0, "packed_tuple needs members");
+          static_assert(
+              !Detail::any_array<Types...>::value,
+              "packed_tuple members cannot be arrays, as for std::tuple"
+            );
+
+          public:
+
+          template <std::size_t Index>
+            using element_type =
+              typename std::tuple_element<Index, std::tuple<Types...>>::type;
+
+          /* The offset of the member with the original Index */
+          template <std::size_t Index>
+            struct offset :
+              std::integral_constant<
+                  std::size_t,
+                  Detail::MakePackedLayout<Types...>().offsets[Index]
+                >
+              {
+              };
+
+          /* Value-initializes each member */
+          packed_tuple()
+            {
+              construct(Indices());
+            }
+
+          /* Initializes each member from the argument with its index */
+          template <
+              class... Args,
+              class = typename std::enable_if<
+                  sizeof...(Args) == sizeof...(Types) &&
+                    Detail::not_self<packed_tuple, Args...>::value
+                >::type
+            >
+            explicit packed_tuple(Args &&... Values)
+              {
+                construct(Indices(), std::forward<Args>(Values)...);
+              }
+
+          packed_tuple(const packed_tuple & Other)
+            {
+              copy(Indices(), Other);
+            }
+
+          /*
+           * Not throwing if no member's move constructor throws, so that
+           * containers such as std::vector move packed_tuples, not copy them
+           */
+          packed_tuple(packed_tuple && Other) noexcept(
+              Detail::all_of<
+                  std::is_nothrow_move_constructible<Types>::value...
+                >::value
+            )
+            {
+              move(Indices(), Other);
+            }
+
+          ~packed_tuple()
+            {
+              destroy(Indices(), sizeof...(Types));
+            }
+
+          packed_tuple & operator=(const packed_tuple & Other)
+            {
+              assign(Indices(), Other);
+              return *this;
+            }
+
+          packed_tuple & operator=(packed_tuple && Other) noexcept(
+              Detail::all_of<
+                  std::is_nothrow_move_assignable<Types>::value...
+                >::value
+            )
+            {
+              move_assign(Indices(), Other);
+              return *this;
+            }
+
+          /* The member with the original Index */
+          template <std::size_t Index>
+            element_type<Index> & get() noexcept
+              {
+                return *reinterpret_cast<element_type<Index> *>(
+                    storage + offset<Index>::value
+                  );
+              }
+
+          template <std::size_t Index>
+            const element_type<Index> & get() const noexcept
+              {
+                return *reinterpret_cast<const element_type<Index> *>(
+                    storage + offset<Index>::value
+                  );
+              }
+
+          private:
+
+          using Indices = std::index_sequence_for<Types...>;
+
+          template <std::size_t... Index>
+            void assign(
+                std::index_sequence<Index...>,
+                const packed_tuple & Other
+              )
+              {
+                int unused[] = { (get<Index>() = Other.get<Index>(), 0)... };
+
+                (void) unused;
+              }
+
+          /*
+           * Constructs each member in turn, from the argument with its index,
+           * or value-initialized if there are no arguments.  If one throws,
+           * the members already constructed are destroyed
+           */
+          template <std::size_t... Index, class... Args>
+            void construct(std::index_sequence<Index...>, Args &&... Values)
+              {
+                std::size_t done = 0;
+
+                try
+                  {
+                    int unused[] =
+                      {
+                        (construct_one<Index>(std::forward<Args>(Values)...),
+                          ++done,
+                          0)...
+                      };
+
+                    (void) unused;
+                  }
+                catch (...)
+                  {
+                    destroy(Indices(), done);
+                    throw;
+                  }
+              }
+
+          template <std::size_t Index>
+            void construct_one()
+              {
+                ::new (static_cast<void *>(storage + offset<Index>::value))
+                  element_type<Index>();
+              }
+
+          template <std::size_t Index, class... Args>
+            void construct_one(Args &&... Values)
+              {
+                ::new (static_cast<void *>(storage + offset<Index>::value))
+                  element_type<Index>(
+                      std::get<Index>(
+                          std::forward_as_tuple(std::forward<Args>(Values)...)
+                        )
+                    );
+              }
+
+          template <std::size_t... Index>
+            void copy(
+                std::index_sequence<Index...>,
+                const packed_tuple & Other
+              )
+              {
+                construct(Indices(), Other.get<Index>()...);
+              }
+
+          /* Destroys the first Count members, in reverse order */
+          template <std::size_t... Index>
+            void destroy(std::index_sequence<Index...>, std::size_t Count)
+              {
+                int unused[] =
+                  {
+                    (sizeof...(Index) - 1 - Index < Count ?
+                      (destroy_one<sizeof...(Index) - 1 - Index>(), 0) :
+                      0)...
+                  };
+
+                (void) unused;
+              }
+
+          template <std::size_t Index>
+            void destroy_one() noexcept
+              {
+                using type = element_type<Index>;
+
+                get<Index>().~type();
+              }
+
+          template <std::size_t... Index>
+            void move(std::index_sequence<Index...>, packed_tuple & Other)
+              {
+                construct(Indices(), std::move(Other.get<Index>())...);
+              }
+
+          template <std::size_t... Index>
+            void move_assign(
+                std::index_sequence<Index...>,
+                packed_tuple & Other
+              )
+              {
+                int unused[] =
+                  {
+                    (get<Index>() = std::move(Other.get<Index>()), 0)...
+                  };
+
+                (void) unused;
+              }
+
+          alignas(Types...) unsigned char storage[
+              Detail::MakePackedLayout<Types...>().size
+            ];
+        };
+
+    /* The member of Tuple with the original Index, as for std::get */
+    template <std::size_t Index, class... Types>
+      auto get(packed_tuple<Types...> & Tuple) noexcept ->
+        typename packed_tuple<Types...>::template element_type<Index> &
+        {
+          return Tuple.template get<Index>();
+        }
+
+    template <std::size_t Index, class... Types>
+      auto get(const packed_tuple<Types...> & Tuple) noexcept ->
+        const typename packed_tuple<Types...>::template element_type<Index> &
+        {
+          return Tuple.template get<Index>();
+        }
+
+    template <std::size_t Index, class... Types>
+      auto get(packed_tuple<Types...> && Tuple) noexcept ->
+        typename packed_tuple<Types...>::template element_type<Index> &&
+        {
+          return std::move(Tuple.template get<Index>());
+        }
+
+    /*
+     * One allocation for a Head and a trailing, opaque object whose size is
+     * only known at run-time, such as a libevent2 'struct event', laid out
+     * by TailAlignedSize.  The head is constructed and destroyed with the
+     * head_tail, and the tail is left for its owner to initialize.  The
+     * storage comes from operator new, which is aligned as malloc is for
+     * AllocHeadTail
+     */
+    template <class Head>
+      class head_tail
+        {
+          public:
+
+          /* The storage needed for a tail of TailSize bytes, or zero */
+          static constexpr std::size_t total_size(std::size_t TailSize)
+            {
+              return Align::TailAlignedSize(sizeof (Head), TailSize);
+            }
+
+          /* The offset of a tail of TailSize bytes */
+          static constexpr std::size_t tail_offset(std::size_t TailSize)
+            {
+              return Align::TailOffset(total_size(TailSize), TailSize);
+            }
+
+          /*
+           * The head, given a pointer to a tail of TailSize bytes, as for
+           * HeadFromTail
+           */
+          static Head & head_from_tail(void * Tail, std::size_t TailSize)
+            {
+              return *static_cast<Head *>(
+                  static_cast<void *>(
+                      static_cast<unsigned char *>(Tail) -
+                        tail_offset(TailSize)
+                    )
+                );
+            }
+
+          /*
+           * Allocates storage for a tail of TailSize bytes and constructs
+           * the head from Args.  Throws std::bad_alloc if TailAlignedSize
+           * would return zero
+           */
+          template <class... Args>
+            explicit head_tail(std::size_t TailSize, Args &&... Values) :
+              storage(nullptr),
+              tail_size(TailSize)
+              {
+                std::size_t size;
+
+                size = total_size(TailSize);
+                if (!size)
+                  throw std::bad_alloc();
+                storage = static_cast<unsigned char *>(::operator new(size));
+                try
+                  {
+                    ::new (static_cast<void *>(storage))
+                      Head(std::forward<Args>(Values)...);
+                  }
+                catch (...)
+                  {
+                    ::operator delete(storage);
+                    throw;
+                  }
+              }
+
+          head_tail(const head_tail &) = delete;
+
+          head_tail(head_tail && Other) noexcept :
+            storage(Other.storage),
+            tail_size(Other.tail_size)
+            {
+              Other.storage = nullptr;
+            }
+
+          ~head_tail()
+            {
+              release();
+            }
+
+          head_tail & operator=(const head_tail &) = delete;
+
+          head_tail & operator=(head_tail && Other) noexcept
+            {
+              if (this != &Other)
+                {
+                  release();
+                  storage = Other.storage;
+                  tail_size = Other.tail_size;
+                  Other.storage = nullptr;
+                }
+              return *this;
+            }
+
+          /* The head, which must not be used after this has been moved */
+          Head & head() noexcept
+            {
+              return *static_cast<Head *>(static_cast<void *>(storage));
+            }
+
+          const Head & head() const noexcept
+            {
+              return *static_cast<const Head *>(
+                  static_cast<const void *>(storage)
+                );
+            }
+
+          /* The size of the storage */
+          std::size_t size() const noexcept
+            {
+              return total_size(tail_size);
+            }
+
+          void * tail() noexcept
+            {
+              return storage + tail_offset(tail_size);
+            }
+
+          const void * tail() const noexcept
+            {
+              return storage + tail_offset(tail_size);
+            }
+
+          private:
+
+          void release() noexcept
+            {
+              if (!storage)
+                return;
+              head().~Head();
+              ::operator delete(storage);
+              storage = nullptr;
+            }
+
+          unsigned char * storage;
+          std::size_t tail_size;
+        };
+  }
+
+/* So that a packed_tuple can be used as a tuple, as by structured bindings */
+namespace std
+  {
+    template <class... Types>
+      struct tuple_size<Align::packed_tuple<Types...>> :
+        integral_constant<size_t, sizeof...(Types)>
+        {
+        };
+
+    template <size_t Index, class... Types>
+      struct tuple_element<Index, Align::packed_tuple<Types...>>
+        {
+          using type = typename tuple_element<Index, tuple<Types...>>::type;
+        };
+  }
+
+#endif /* DIncluded_align_hpp */
@@ -0,0 +1,461 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A test of align.hpp.  The layouts of packed_tuples are checked at
+ * compile-time, and their construction, copying, moving and assignment at
+ * run-time, including members whose constructors throw.  head_tail is
+ * checked by a round-trip from its head to its tail and back.  Nothing
+ * needs to be linked in:
+ *
+ *   g++ -std=c++14 -pedantic -Wall -Wextra -Werror -o align_test \
+ *     align_test.cpp
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "align.hpp"
+
+namespace
+  {
+    /* Counts its copies, moves and live objects */
+    struct counted
+      {
+        counted()
+          {
+            ++live;
+          }
+
+        counted(const counted &)
+          {
+            ++copies;
+            ++live;
+          }
+
+        counted(counted &&) noexcept
+          {
+            ++moves;
+            ++live;
+          }
+
+        ~counted()
+          {
+            --live;
+          }
+
+        counted & operator=(const counted &) = default;
+        counted & operator=(counted &&) noexcept = default;
+
+        static int copies;
+        static int live;
+        static int moves;
+      };
+
+    int counted::copies;
+    int counted::live;
+    int counted::moves;
+
+    /* A head for head_tail, with a constructor which might throw */
+    struct head
+      {
+        head(int Number, double Value) :
+          number(Number),
+          value(Value)
+          {
+            if (Number < 0)
+              throw Number;
+          }
+
+        int number;
+        double value;
+      };
+
+    /* Throws from its constructors while fail is set */
+    struct thrower
+      {
+        thrower()
+          {
+            if (fail)
+              throw 1;
+          }
+
+        thrower(const thrower &)
+          {
+            if (fail)
+              throw 1;
+          }
+
+        /* A move which might throw, as far as the type traits know */
+        thrower(thrower &&)
+          {
+          }
+
+        thrower & operator=(const thrower &) = default;
+        thrower & operator=(thrower &&) = default;
+
+        static bool fail;
+      };
+
+    bool thrower::fail;
+
+    using mixed = Align::packed_tuple<char, double, short, int>;
+
+    /* With conventional alignments, the members go in descending order */
+    static_assert(
+        alignof(double) < sizeof (double) ||
+          alignof(int) < sizeof (int) ||
+          alignof(short) < sizeof (short) ||
+          (mixed::offset<1>::value == 0 &&
+            mixed::offset<3>::value == sizeof (double) &&
+            mixed::offset<2>::value == sizeof (double) + sizeof (int) &&
+            mixed::offset<0>::value ==
+              sizeof (double) + sizeof (int) + sizeof (short)),
+        "packed_tuple members are not in descending order of alignment"
+      );
+    static_assert(
+        alignof(mixed) == alignof(double),
+        "packed_tuple is not aligned for its strictest member"
+      );
+    static_assert(
+        sizeof (mixed) % alignof(double) == 0 &&
+          sizeof (mixed) - (sizeof (double) + sizeof (int) +
+            sizeof (short) + sizeof (char)) < alignof(double),
+        "packed_tuple has more padding than its end needs"
+      );
+    /* Members with the same alignment and size keep their order */
+    static_assert(
+        Align::packed_tuple<int, int, int>::offset<0>::value == 0 &&
+          Align::packed_tuple<int, int, int>::offset<1>::value ==
+            sizeof (int) &&
+          Align::packed_tuple<int, int, int>::offset<2>::value ==
+            2 * sizeof (int),
+        "packed_tuple does not keep the order of equal members"
+      );
+    static_assert(
+        std::tuple_size<mixed>::value == 4 &&
+          std::is_same<std::tuple_element<1, mixed>::type, double>::value,
+        "packed_tuple is not usable as a tuple"
+      );
+    static_assert(
+        std::is_nothrow_move_constructible<
+            Align::packed_tuple<counted, int>
+          >::value &&
+          std::is_nothrow_move_assignable<
+              Align::packed_tuple<counted, int>
+            >::value,
+        "packed_tuple moves can throw although its members' cannot"
+      );
+    static_assert(
+        !std::is_nothrow_move_constructible<
+            Align::packed_tuple<counted, thrower>
+          >::value,
+        "packed_tuple moves cannot throw although a member's can"
+      );
+    static_assert(
+        Align::head_tail<head>::total_size(100) ==
+          Align::TailAlignedSize(sizeof (head), 100) &&
+          Align::head_tail<head>::tail_offset(100) + 100 ==
+            Align::head_tail<head>::total_size(100),
+        "head_tail does not put the tail at the end"
+      );
+
+    int check_head_tail(void);
+    int check_packed_copy(void);
+    int check_packed_throw(void);
+    int check_packed_vector(void);
+
+    /* A round-trip from the head to the tail and back */
+    int check_head_tail(void)
+      {
+        std::size_t factor;
+        bool threw;
+        std::size_t tail_size;
+
+        for (tail_size = 1; tail_size <= 200; ++tail_size)
+          {
+            Align::head_tail<head> record(tail_size, 7, 0.5);
+            Align::head_tail<head> moved(std::move(record));
+
+            factor = Align::LargestPowerOfTwoFactor(tail_size);
+            if (factor > alignof(std::max_align_t))
+              factor = alignof(std::max_align_t);
+            if (moved.size() != Align::TailAlignedSize(
+                sizeof (head),
+                tail_size
+              ) ||
+              reinterpret_cast<std::uintptr_t>(moved.tail()) % factor ||
+              static_cast<unsigned char *>(moved.tail()) + tail_size !=
+                reinterpret_cast<unsigned char *>(&moved.head()) +
+                  moved.size())
+              {
+                std::fprintf(
+                    stderr,
+                    "align_test: head_tail misplaced a tail of %lu bytes\n",
+                    static_cast<unsigned long>(tail_size)
+                  );
+                return 1;
+              }
+            std::memset(moved.tail(), 0xFF, tail_size);
+            if (&Align::head_tail<head>::head_from_tail(
+                moved.tail(),
+                tail_size
+              ) != &moved.head() ||
+              moved.head().number != 7 ||
+              moved.head().value != 0.5)
+              {
+                std::fprintf(
+                    stderr,
+                    "align_test: head_tail lost its head with a tail of "
+                    "%lu bytes\n",
+                    static_cast<unsigned long>(tail_size)
+                  );
+                return 1;
+              }
+          }
+
+        /* The storage is freed if the head throws, as ASan would show */
+        threw = false;
+        try
+          {
+            Align::head_tail<head> record(16, -1, 0.0);
+          }
+        catch (int)
+          {
+            threw = true;
+          }
+        if (!threw)
+          {
+            std::fprintf(stderr, "align_test: a head did not throw\n");
+            return 1;
+          }
+
+        threw = false;
+        try
+          {
+            Align::head_tail<head> record(0, 1, 0.0);
+          }
+        catch (const std::bad_alloc &)
+          {
+            threw = true;
+          }
+        if (!threw)
+          {
+            std::fprintf(stderr, "align_test: an empty tail was allowed\n");
+            return 1;
+          }
+        return 0;
+      }
+
+    /* Copying, moving and assigning keep each member's value */
+    int check_packed_copy(void)
+      {
+        Align::packed_tuple<int, std::string, char> assigned;
+        Align::packed_tuple<int, std::string, char> original(
+            3,
+            "a string too long to be stored in a std::string itself",
+            'x'
+          );
+        Align::packed_tuple<int, std::string, char> copy(original);
+        Align::packed_tuple<int, std::string, char> moved(std::move(copy));
+
+        if (Align::get<0>(assigned) != 0 ||
+          !Align::get<1>(assigned).empty() ||
+          Align::get<2>(assigned) != 0)
+          {
+            std::fprintf(
+                stderr,
+                "align_test: packed_tuple was not value-initialized\n"
+              );
+            return 1;
+          }
+        if (Align::get<0>(moved) != 3 ||
+          Align::get<1>(moved) != Align::get<1>(original) ||
+          Align::get<2>(moved) != 'x' ||
+          Align::get<0>(original) != 3 ||
+          Align::get<2>(original) != 'x')
+          {
+            std::fprintf(
+                stderr,
+                "align_test: packed_tuple lost a value being copied or "
+                "moved\n"
+              );
+            return 1;
+          }
+
+        assigned = original;
+        if (Align::get<1>(assigned) != Align::get<1>(original))
+          {
+            std::fprintf(
+                stderr,
+                "align_test: packed_tuple lost a value being assigned\n"
+              );
+            return 1;
+          }
+        Align::get<1>(assigned).clear();
+        assigned = std::move(moved);
+        if (Align::get<0>(assigned) != 3 ||
+          Align::get<1>(assigned) != Align::get<1>(original) ||
+          Align::get<2>(assigned) != 'x')
+          {
+            std::fprintf(
+                stderr,
+                "align_test: packed_tuple lost a value being move-assigned\n"
+              );
+            return 1;
+          }
+        return 0;
+      }
+
+    /* Members already constructed are destroyed when a later one throws */
+    int check_packed_throw(void)
+      {
+        bool threw;
+
+        thrower::fail = false;
+        {
+          Align::packed_tuple<counted, thrower, counted> original;
+
+          thrower::fail = true;
+          threw = false;
+          try
+            {
+              Align::packed_tuple<counted, thrower, counted> copy(original);
+            }
+          catch (int)
+            {
+              threw = true;
+            }
+          if (!threw || counted::live != 2)
+            {
+              std::fprintf(
+                  stderr,
+                  "align_test: a throwing copy left %d members alive\n",
+                  counted::live - 2
+                );
+              return 1;
+            }
+
+          threw = false;
+          try
+            {
+              Align::packed_tuple<counted, thrower, counted> another;
+            }
+          catch (int)
+            {
+              threw = true;
+            }
+          thrower::fail = false;
+          if (!threw || counted::live != 2)
+            {
+              std::fprintf(
+                  stderr,
+                  "align_test: a throwing construction left %d members "
+                  "alive\n",
+                  counted::live - 2
+                );
+              return 1;
+            }
+        }
+        if (counted::live)
+          {
+            std::fprintf(
+                stderr,
+                "align_test: %d packed_tuple members were not destroyed\n",
+                counted::live
+              );
+            return 1;
+          }
+        return 0;
+      }
+
+    /* A std::vector moves its packed_tuples when it grows */
+    int check_packed_vector(void)
+      {
+        int i;
+        std::vector<Align::packed_tuple<counted, int>> tuples;
+
+        counted::copies = 0;
+        counted::moves = 0;
+        for (i = 0; i < 100; ++i)
+          tuples.emplace_back(counted(), i);
+        for (i = 0; i < 100; ++i)
+          {
+            if (Align::get<1>(tuples[i]) != i)
+              {
+                std::fprintf(
+                    stderr,
+                    "align_test: a std::vector lost packed_tuple %d\n",
+                    i
+                  );
+                return 1;
+              }
+          }
+        if (counted::copies || counted::moves <= 100)
+          {
+            std::fprintf(
+                stderr,
+                "align_test: a std::vector copied %d and moved %d members\n",
+                counted::copies,
+                counted::moves
+              );
+            return 1;
+          }
+        return 0;
+      }
+  }
+
+int main(void)
+  {
+    int failed;
+
+    failed = check_head_tail();
+    failed |= check_packed_copy();
+    failed |= check_packed_throw();
+    failed |= check_packed_vector();
+    if (failed)
+      return EXIT_FAILURE;
+    std::printf("align_test: ok\n");
+    return EXIT_SUCCESS;
+  }
@@ -0,0 +1,404 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * Reads descriptions of structures and reports how much each would shrink
+ * with its members reordered.  Each line of input describes one structure:
+ * its name, then each of its members in declared order, as the member's
+ * size and, optionally, a colon and its alignment, such as:
+ *
+ *   struct_event 2:1 8 4 8:8 6:2
+ *
+ * A member without an alignment is taken to be aligned to the largest
+ * power-of-two factor of its size.  Anything after a '#' on a line is
+ * ignored.  The input is read a token at a time, so neither a file nor a
+ * line need fit in memory.  A line of comma-separated values is printed
+ * for each structure, and a summary to the standard error stream.
+ *   This format is the only input.  JSON and the record layouts dumped by
+ * compilers are not read: a short script can turn either into this format,
+ * and parsing them would need far more code than the analysis itself
+ */
+/* C >= C99 required for SIZE_MAX */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "align.h"
+#include "layout.h"
+
+/* Longest name or member token kept; longer ones are truncated */
+#define DTokenSize 256
+/* Results of read_token */
+#define DTokenEof (-1)
+#define DTokenEnd 0
+#define DTokenWord 1
+
+/* Totals for the summary */
+struct analysis
+  {
+    size_t declared;
+    size_t errors;
+    size_t improvable;
+    size_t optimal;
+    size_t structs;
+  };
+
+/* Storage for the members of one structure, grown as needed */
+struct members
+  {
+    size_t capacity;
+    size_t count;
+    struct layout_member * members;
+    size_t * order;
+    struct layout_member * sorted;
+  };
+
+static int analyze_file(
+    FILE * File,
+    const char * FileName,
+    struct members * Members,
+    struct analysis * Analysis
+  );
+static void analyze_struct(
+    const char * FileName,
+    unsigned long Line,
+    const char * Name,
+    struct members * Members,
+    struct analysis * Analysis
+  );
+static int grow_members(struct members * Members);
+static int parse_member(const char * Token, struct layout_member * Member);
+static int read_token(
+    FILE * File,
+    char * Buffer,
+    size_t Size,
+    unsigned long * Line
+  );
+
+int main(int argc, char ** argv)
+  {
+    struct analysis analysis;
+    FILE * file;
+    int i;
+    struct members members;
+    int status;
+
+    analysis.declared = 0;
+    analysis.errors = 0;
+    analysis.improvable = 0;
+    analysis.optimal = 0;
+    analysis.structs = 0;
+    members.capacity = 0;
+    members.count = 0;
+    members.members = NULL;
+    members.order = NULL;
+    members.sorted = NULL;
+
+    printf("name,members,declared,sorted,optimal,saved,method\n");
+    status = EXIT_SUCCESS;
+    if (argc < 2 && !analyze_file(stdin, "-", &members, &analysis))
+      status = EXIT_FAILURE;
+    for (i = 1; i < argc; ++i)
+      {
+        file = argv[i][0] == '-' && !argv[i][1] ? stdin : fopen(argv[i], "r");
+        if (!file)
+          {
+            fprintf(stderr, "%s: Could not open\n", argv[i]);
+            status = EXIT_FAILURE;
+            continue;
+          }
+        if (!analyze_file(file, argv[i], &members, &analysis))
+          status = EXIT_FAILURE;
+        if (file != stdin)
+          fclose(file);
+      }
+    free(members.members);
+
+    fprintf(
+        stderr,
+        "%lu structures, %lu bytes declared, %lu bytes optimal, "
+          "%lu bytes saved in %lu structures, %lu errors\n",
+        (unsigned long) analysis.structs,
+        (unsigned long) analysis.declared,
+        (unsigned long) analysis.optimal,
+        (unsigned long) (analysis.declared - analysis.optimal),
+        (unsigned long) analysis.improvable,
+        (unsigned long) analysis.errors
+      );
+    if (analysis.errors)
+      status = EXIT_FAILURE;
+    return status;
+  }
+
+/*
+ * Reads and analyzes each structure described in File.  Returns zero if
+ * there was not enough memory or a read error, or non-zero otherwise
+ */
+static int analyze_file(
+    FILE * File,
+    const char * FileName,
+    struct members * Members,
+    struct analysis * Analysis
+  )
+  {
+    int bad;
+    unsigned long line;
+    char name[DTokenSize];
+    unsigned long start;
+    int token;
+    char word[DTokenSize];
+
+    line = 1;
+    for (;;)
+      {
+        start = line;
+        token = read_token(File, name, sizeof name, &line);
+        if (token == DTokenEof)
+          break;
+        if (token == DTokenEnd)
+          continue;
+
+        bad = 0;
+        Members->count = 0;
+        for (;;)
+          {
+            token = read_token(File, word, sizeof word, &line);
+            if (token != DTokenWord)
+              break;
+            if (Members->count == Members->capacity && !grow_members(Members))
+              {
+                fprintf(stderr, "%s:%lu: Out of memory\n", FileName, start);
+                return 0;
+              }
+            if (!parse_member(word, Members->members + Members->count))
+              bad = 1;
+            ++Members->count;
+          }
+
+        if (bad || !Members->count)
+          {
+            fprintf(
+                stderr,
+                "%s:%lu: %s: Bad member description\n",
+                FileName,
+                start,
+                name
+              );
+            ++Analysis->errors;
+          }
+          else
+          analyze_struct(FileName, start, name, Members, Analysis);
+        if (token == DTokenEof)
+          break;
+      }
+
+    if (ferror(File))
+      {
+        fprintf(stderr, "%s: Read error\n", FileName);
+        return 0;
+      }
+    return 1;
+  }
+
+/* Used by analyze_file.  Prints and totals the results for one structure */
+static void analyze_struct(
+    const char * FileName,
+    unsigned long Line,
+    const char * Name,
+    struct members * Members,
+    struct analysis * Analysis
+  )
+  {
+    size_t declared;
+    size_t i;
+    size_t optimal;
+    struct layout_result result;
+    size_t sorted;
+
+    optimal = LayoutMembers(
+        Members->members,
+        Members->count,
+        Members->order,
+        NULL,
+        &result
+      );
+    declared = LayoutMembersDeclared(Members->members, Members->count, NULL);
+    if (!optimal || !declared)
+      {
+        fprintf(
+            stderr,
+            "%s:%lu: %s: Sizes or alignments are not valid\n",
+            FileName,
+            Line,
+            Name
+          );
+        ++Analysis->errors;
+        return;
+      }
+
+    /* The usual advice: sort by alignment, and then by size */
+    for (i = 0; i < Members->count; ++i)
+      Members->sorted[i] = Members->members[i];
+    SortAlignmentsDescending(
+        &Members->sorted->size,
+        Members->count,
+        sizeof *Members->sorted,
+        offsetof(struct layout_member, align)
+      );
+    sorted = LayoutMembersDeclared(Members->sorted, Members->count, NULL);
+
+    printf(
+        "%s,%lu,%lu,%lu,%lu,%lu,%s\n",
+        Name,
+        (unsigned long) Members->count,
+        (unsigned long) declared,
+        (unsigned long) sorted,
+        (unsigned long) optimal,
+        (unsigned long) (declared - optimal),
+        result.method == DLayoutExact ? "exact" : "greedy"
+      );
+    ++Analysis->structs;
+    Analysis->declared += declared;
+    Analysis->optimal += optimal;
+    if (optimal < declared)
+      ++Analysis->improvable;
+  }
+
+/*
+ * Used by analyze_file.  Doubles the capacity of Members.  Returns zero if
+ * there was not enough memory, or non-zero otherwise
+ */
+static int grow_members(struct members * Members)
+  {
+    size_t capacity;
+    size_t each;
+    struct layout_member * members;
+
+    capacity = Members->capacity ? 2 * Members->capacity : 16;
+    each = 2 * sizeof *members + sizeof *Members->order;
+    if (capacity > SIZE_MAX / each)
+      return 0;
+    members = realloc(Members->members, capacity * each);
+    if (!members)
+      return 0;
+
+    /* The other arrays follow, and their contents need not be kept */
+    Members->capacity = capacity;
+    Members->members = members;
+    Members->sorted = members + capacity;
+    Members->order = (size_t *) (Members->sorted + capacity);
+    return 1;
+  }
+
+/*
+ * Used by analyze_file.  Parses a member token: a size, optionally followed
+ * by a colon and an alignment.  Returns zero if the token is not valid, or
+ * non-zero otherwise
+ */
+static int parse_member(const char * Token, struct layout_member * Member)
+  {
+    char * end;
+    unsigned long value;
+
+    Member->align = 0;
+    Member->group = 0;
+    Member->weight = 0;
+    value = strtoul(Token, &end, 10);
+    if (end == Token || *Token == '-' || value == ULONG_MAX ||
+      value > SIZE_MAX)
+      return 0;
+    Member->size = value;
+    if (*end == ':')
+      {
+        Token = end + 1;
+        value = strtoul(Token, &end, 10);
+        if (end == Token || *Token == '-' || value == ULONG_MAX ||
+          value > SIZE_MAX)
+          return 0;
+        Member->align = value;
+      }
+    return !*end;
+  }
+
+/*
+ * Used by analyze_file.  Reads the next token from File into Buffer, which
+ * has Size bytes.  Returns DTokenWord for a token, DTokenEnd for the end of
+ * a line, or DTokenEof for the end of File
+ */
+static int read_token(
+    FILE * File,
+    char * Buffer,
+    size_t Size,
+    unsigned long * Line
+  )
+  {
+    int c;
+    size_t length;
+
+    do
+      c = getc(File);
+      while (c == ' ' || c == '\t' || c == '\r');
+    if (c == '#')
+      {
+        do
+          c = getc(File);
+          while (c != '\n' && c != EOF);
+      }
+    if (c == EOF)
+      return DTokenEof;
+    if (c == '\n')
+      {
+        ++*Line;
+        return DTokenEnd;
+      }
+
+    length = 0;
+    do
+      {
+        if (length < Size - 1)
+          Buffer[length++] = (char) c;
+        c = getc(File);
+      }
+      while (c != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n' &&
+        c != '#');
+    Buffer[length] = '\0';
+    if (c != EOF)
+      ungetc(c, File);
+    return DTokenWord;
+  }
@@ -0,0 +1,680 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* A monotonic clock needs POSIX, where there is one */
+#ifdef __linux__
+#define _POSIX_C_SOURCE 199309L
+#endif
+/* C >= C99 required for SIZE_MAX */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "align.h"
+
+#define DCountOf(arr) (sizeof (arr) / sizeof *(arr))
+/* Operations timed by each repetition, spread over passes of the sizes */
+#define DBenchOperations ((size_t) 1 << 20)
+/* Timed repetitions of each measurement, after one untimed warm-up */
+#define DBenchRepetitions 5
+/*
+ * The path taken by TailAlignedSize and PaddingSize for small sizes, when
+ * align.c is built with the same flags as this file, so that the output of
+ * two builds can be put together to compare them
+ */
+#ifdef DAlignSmallTable
+#define DBenchSmallPath "table"
+#else
+#define DBenchSmallPath "branchless"
+#endif
+
+/*
+ * A function being measured, applied to Count heads and tails, with a
+ * result for each stored into Out
+ */
+typedef void bench_kernel(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+
+struct bench_case
+  {
+    const char * function;
+    /* The implementation: reference, branchless, batch and so on */
+    const char * path;
+    bench_kernel * kernel;
+    /* What the results must match, or a null pointer for a reference */
+    bench_kernel * reference;
+  };
+
+struct bench_distribution
+  {
+    const char * name;
+    size_t (* generate)(unsigned long * State);
+  };
+
+static void bench(
+    const struct bench_case * Case,
+    const struct bench_distribution * Distribution,
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static int bench_check(
+    const struct bench_case * Case,
+    const struct bench_distribution * Distribution,
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t * Expected,
+    size_t Count
+  );
+static size_t bench_edge(unsigned long * State);
+static size_t bench_huge(unsigned long * State);
+static size_t bench_mixed(unsigned long * State);
+static double bench_now(void);
+static size_t bench_odd(unsigned long * State);
+static size_t bench_power(unsigned long * State);
+static unsigned long bench_random(unsigned long * State);
+static int double_sorter(const void * a, const void * b);
+static void kernel_factor(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_factor_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_padding(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_padding_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_sort(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_sort_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_tail_aligned_size(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_tail_aligned_size_batch(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static void kernel_tail_aligned_size_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  );
+static size_t reference_factor(size_t Number);
+static int reference_sorter(const void * a, const void * b);
+static size_t reference_tail_aligned_size(size_t HeadSize, size_t TailSize);
+
+/* Results are added here, so that the kernels are not optimized away */
+static volatile size_t bench_sink;
+
+int main(void)
+  {
+    static const struct bench_case cases[] =
+      {
+        {
+          "LargestPowerOfTwoFactor",
+          "reference",
+          kernel_factor_reference,
+          0
+        },
+        {
+          "LargestPowerOfTwoFactor",
+          "branchless",
+          kernel_factor,
+          kernel_factor_reference
+        },
+        {
+          "TailAlignedSize",
+          "reference",
+          kernel_tail_aligned_size_reference,
+          0
+        },
+        {
+          "TailAlignedSize",
+          DBenchSmallPath,
+          kernel_tail_aligned_size,
+          kernel_tail_aligned_size_reference
+        },
+        {
+          "TailAlignedSize",
+          "batch",
+          kernel_tail_aligned_size_batch,
+          kernel_tail_aligned_size_reference
+        },
+        { "PaddingSize", "reference", kernel_padding_reference, 0 },
+        {
+          "PaddingSize",
+          DBenchSmallPath,
+          kernel_padding,
+          kernel_padding_reference
+        },
+        { "SortSizesDescending", "qsort", kernel_sort_reference, 0 },
+        {
+          "SortSizesDescending",
+          "radix",
+          kernel_sort,
+          kernel_sort_reference
+        }
+      };
+    static const size_t counts[] = { 16, 1024, 65536 };
+    static const struct bench_distribution distributions[] =
+      {
+        { "odd", bench_odd },
+        { "power", bench_power },
+        { "mixed", bench_mixed },
+        { "huge", bench_huge },
+        { "edge", bench_edge }
+      };
+    size_t count;
+    size_t * expected;
+    size_t * heads;
+    size_t i;
+    size_t j;
+    size_t k;
+    size_t * out;
+    unsigned long state;
+    size_t * tails;
+
+    count = counts[DCountOf(counts) - 1];
+    heads = malloc(4 * count * sizeof *heads);
+    if (!heads)
+      {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+      }
+    tails = heads + count;
+    out = tails + count;
+    expected = out + count;
+
+    printf(
+        "function,path,distribution,count,repetitions,"
+        "ns_per_op_median,ns_per_op_min,ops_per_sec\n"
+      );
+    for (i = 0; i < DCountOf(distributions); ++i)
+      {
+        state = 1;
+        for (k = 0; k < count; ++k)
+          {
+            heads[k] = distributions[i].generate(&state);
+            tails[k] = distributions[i].generate(&state);
+          }
+        for (j = 0; j < DCountOf(counts); ++j)
+          {
+            for (k = 0; k < DCountOf(cases); ++k)
+              {
+                if (!bench_check(
+                    cases + k,
+                    distributions + i,
+                    heads,
+                    tails,
+                    out,
+                    expected,
+                    counts[j]
+                  ))
+                  {
+                    free(heads);
+                    return EXIT_FAILURE;
+                  }
+                bench(
+                    cases + k,
+                    distributions + i,
+                    heads,
+                    tails,
+                    out,
+                    counts[j]
+                  );
+              }
+          }
+      }
+
+    free(heads);
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * Runs a kernel over Count sizes for enough passes to make up
+ * DBenchOperations, once untimed to warm up, then for DBenchRepetitions
+ * timed repetitions, and prints a line of the results
+ */
+static void bench(
+    const struct bench_case * Case,
+    const struct bench_distribution * Distribution,
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+    size_t operations;
+    size_t pass;
+    size_t passes;
+    double start;
+    double times[DBenchRepetitions];
+
+    passes = DBenchOperations / Count;
+    if (!passes)
+      passes = 1;
+    operations = passes * Count;
+
+    for (i = 0; i <= DBenchRepetitions; ++i)
+      {
+        start = bench_now();
+        for (pass = 0; pass < passes; ++pass)
+          {
+            Case->kernel(Heads, Tails, Out, Count);
+            bench_sink += Out[Count / 2];
+          }
+        /* The first is the warm-up */
+        if (i)
+          times[i - 1] = (bench_now() - start) * 1e9 / operations;
+      }
+
+    qsort(times, DBenchRepetitions, sizeof *times, double_sorter);
+    printf(
+        "%s,%s,%s,%lu,%d,%.3f,%.3f,%.0f\n",
+        Case->function,
+        Case->path,
+        Distribution->name,
+        (unsigned long) Count,
+        DBenchRepetitions,
+        times[DBenchRepetitions / 2],
+        times[0],
+        times[DBenchRepetitions / 2] > 0 ?
+          1e9 / times[DBenchRepetitions / 2] :
+          0
+      );
+  }
+
+/*
+ * Runs a kernel and the kernel it is measured against over Count sizes
+ * and returns 1 if all of the results are the same, so that a fast but
+ * wrong path cannot go unnoticed, or prints why not and returns 0
+ */
+static int bench_check(
+    const struct bench_case * Case,
+    const struct bench_distribution * Distribution,
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t * Expected,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    if (!Case->reference)
+      return 1;
+    Case->kernel(Heads, Tails, Out, Count);
+    Case->reference(Heads, Tails, Expected, Count);
+    for (i = 0; i < Count; ++i)
+      {
+        if (Out[i] == Expected[i])
+          continue;
+        fprintf(
+            stderr,
+            "bench: %s (%s) gave %lu instead of %lu at %lu of %lu %s "
+            "sizes\n",
+            Case->function,
+            Case->path,
+            (unsigned long) Out[i],
+            (unsigned long) Expected[i],
+            (unsigned long) i,
+            (unsigned long) Count,
+            Distribution->name
+          );
+        return 0;
+      }
+    return 1;
+  }
+
+/*
+ * Sizes at the edges of the table of DAlignSmallTable, which covers sizes
+ * below 4096, including zero
+ */
+static size_t bench_edge(unsigned long * State)
+  {
+    unsigned long r;
+
+    r = bench_random(State);
+    switch (r % 4)
+      {
+        case 0:
+          return 0;
+        case 1:
+          return 4096 - 1 - r / 4 % 8;
+        case 2:
+          return 4096 + r / 4 % 8;
+        default:
+          return r / 4 % 8192;
+      }
+  }
+
+/* Sizes near SIZE_MAX, with power-of-two factors up to 2^31 */
+static size_t bench_huge(unsigned long * State)
+  {
+    size_t mask;
+
+    mask = ((size_t) 1 << (bench_random(State) % 32)) - 1;
+    return (SIZE_MAX - bench_random(State) % 4096) & ~mask;
+  }
+
+/*
+ * Sizes as for the members of structures: mostly small multiples of four
+ * and eight, with some strings and some larger objects
+ */
+static size_t bench_mixed(unsigned long * State)
+  {
+    unsigned long r;
+
+    r = bench_random(State);
+    switch (r % 8)
+      {
+        case 0:
+        case 1:
+        case 2:
+          return 8 * (1 + r / 8 % 8);
+        case 3:
+        case 4:
+          return 4 * (1 + r / 8 % 16);
+        case 5:
+          return 1 + r / 8 % 32;
+        case 6:
+          return 2 * (1 + r / 8 % 8);
+        default:
+          return 16 * (1 + r / 8 % 256);
+      }
+  }
+
+/* Returns seconds from some fixed point */
+static double bench_now(void)
+  {
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+    return (double) clock() / CLOCKS_PER_SEC;
+#endif
+  }
+
+/* Small odd sizes, such as for character arrays */
+static size_t bench_odd(unsigned long * State)
+  {
+    return 2 * (bench_random(State) % 128) + 1;
+  }
+
+/* Powers of two, as for scalar types and their arrays */
+static size_t bench_power(unsigned long * State)
+  {
+    return (size_t) 1 << bench_random(State) % 16;
+  }
+
+/* A linear congruential generator, for the same sizes on every platform */
+static unsigned long bench_random(unsigned long * State)
+  {
+    *State = (*State * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    return *State >> 8;
+  }
+
+/* Used by bench */
+static int double_sorter(const void * a, const void * b)
+  {
+    double da;
+    double db;
+
+    da = *(const double *) a;
+    db = *(const double *) b;
+    if (da < db)
+      return -1;
+    if (da > db)
+      return 1;
+    return 0;
+  }
+
+static void kernel_factor(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    (void) Tails;
+    for (i = 0; i < Count; ++i)
+      Out[i] = LargestPowerOfTwoFactor(Heads[i]);
+  }
+
+static void kernel_factor_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    (void) Tails;
+    for (i = 0; i < Count; ++i)
+      Out[i] = reference_factor(Heads[i]);
+  }
+
+static void kernel_padding(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    for (i = 0; i < Count; ++i)
+      Out[i] = PaddingSize(Heads[i], Tails[i]);
+  }
+
+static void kernel_padding_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+    size_t total_size;
+
+    for (i = 0; i < Count; ++i)
+      {
+        total_size = reference_tail_aligned_size(Heads[i], Tails[i]);
+        Out[i] = total_size ? total_size - Tails[i] - Heads[i] : SIZE_MAX;
+      }
+  }
+
+/* The cost of copying the unsorted sizes is included */
+static void kernel_sort(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    (void) Tails;
+    memcpy(Out, Heads, Count * sizeof *Out);
+    SortSizesDescending(Out, Count, sizeof *Out);
+  }
+
+static void kernel_sort_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    (void) Tails;
+    memcpy(Out, Heads, Count * sizeof *Out);
+    qsort(Out, Count, sizeof *Out, reference_sorter);
+  }
+
+static void kernel_tail_aligned_size(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    for (i = 0; i < Count; ++i)
+      Out[i] = TailAlignedSize(Heads[i], Tails[i]);
+  }
+
+static void kernel_tail_aligned_size_batch(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    TailAlignedSizeBatch(Heads, Tails, Out, Count);
+  }
+
+static void kernel_tail_aligned_size_reference(
+    const size_t * Heads,
+    const size_t * Tails,
+    size_t * Out,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    for (i = 0; i < Count; ++i)
+      Out[i] = reference_tail_aligned_size(Heads[i], Tails[i]);
+  }
+
+/* The original LargestPowerOfTwoFactor, for comparison */
+static size_t reference_factor(size_t Number)
+  {
+    size_t npow;
+    size_t pow;
+
+    npow = pow = 1;
+    while (Number >= npow && !(Number % npow) && SIZE_MAX - npow >= npow)
+      {
+        pow = npow;
+        npow *= 2;
+      }
+    return pow;
+  }
+
+/* The original comparison for SortSizesDescending, for comparison */
+static int reference_sorter(const void * a, const void * b)
+  {
+    size_t sa;
+    size_t sb;
+
+    sa = *(const size_t *) a;
+    sb = *(const size_t *) b;
+    if (sa < sb)
+      return 1;
+    if (sa > sb)
+      return -1;
+    return 0;
+  }
+
+/* The original TailAlignedSize, for comparison */
+static size_t reference_tail_aligned_size(size_t HeadSize, size_t TailSize)
+  {
+    size_t factor;
+    size_t padding;
+    size_t remainder;
+    size_t sum;
+
+    if (!HeadSize || !TailSize || SIZE_MAX - HeadSize < TailSize)
+      return 0;
+    factor = reference_factor(HeadSize);
+    if (reference_factor(TailSize) > factor)
+      factor = reference_factor(TailSize);
+
+    sum = HeadSize + TailSize;
+    remainder = sum % factor;
+    if (remainder)
+      {
+        padding = factor - remainder;
+        if (SIZE_MAX - sum < padding)
+          return 0;
+        sum += padding;
+      }
+    return sum;
+  }
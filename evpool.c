@@ -0,0 +1,120 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#include <stddef.h>
+#include <event2/event.h>
+#include "align.h"
+#include "evpool.h"
+#include "pool.h"
+
+void * EvPoolContext(const struct evpool * Pool, struct event * Event)
+  {
+    return HeadFromTail(Event, &Pool->layout);
+  }
+
+void EvPoolDestroy(struct evpool * Pool)
+  {
+    PoolDestroy(&Pool->pool);
+  }
+
+struct event * EvPoolEvent(const struct evpool * Pool, void * Context)
+  {
+    return TailFromHead(Context, &Pool->layout);
+  }
+
+void EvPoolFree(struct evpool * Pool, void * Context)
+  {
+    if (!Context)
+      return;
+    event_del(EvPoolEvent(Pool, Context));
+    PoolFree(&Pool->pool, Context);
+  }
+
+size_t EvPoolInit(
+    struct evpool * Pool,
+    size_t ContextSize,
+    size_t RefillCount
+  )
+  {
+    size_t event_align;
+    size_t event_size;
+
+    if (!Pool)
+      return 0;
+
+    /* The size is only known at run-time, but does not change */
+    event_size = event_get_struct_event_size();
+    event_align = LargestPowerOfTwoFactor(event_size);
+    if (event_align > DEvPoolEventAlign)
+      event_align = DEvPoolEventAlign;
+    if (!PoolInitEx(
+        &Pool->pool,
+        ContextSize,
+        0,
+        event_size,
+        event_align,
+        RefillCount
+      ))
+      return 0;
+    PoolGetLayout(&Pool->pool, &Pool->layout);
+    return Pool->layout.total_size;
+  }
+
+void * EvPoolNew(
+    struct evpool * Pool,
+    struct event_base * Base,
+    evutil_socket_t Fd,
+    short Events,
+    event_callback_fn Callback,
+    struct event ** Event
+  )
+  {
+    void * context;
+    void * event;
+
+    context = PoolAlloc(&Pool->pool, &event);
+    if (context && event_assign(event, Base, Fd, Events, Callback, context))
+      {
+        PoolFree(&Pool->pool, context);
+        context = NULL;
+      }
+    if (Event)
+      *Event = context ? event : NULL;
+    return context;
+  }
@@ -0,0 +1,129 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_evpool
+#define DIncluded_evpool 1
+#include <stddef.h>
+#include <event2/event.h>
+#include "align.h"
+#include "pool.h"
+
+/*
+ * The most alignment assumed of a 'struct event'.  libevent2 allocates one
+ * with malloc, which aligns to 16 bytes on common 64-bit platforms, so no
+ * more can be needed.  Inferring the alignment from the size instead would
+ * align a 128-byte event to 128 bytes, and a record of a 24-byte context
+ * and such an event would then take 256 bytes rather than 160
+ */
+#ifndef DEvPoolEventAlign
+#define DEvPoolEventAlign 16
+#endif
+
+/*
+ * A pool of records of a context and a trailing libevent2 'struct event',
+ * each obtained with one allocation from a pool, instead of one for the
+ * context and another from event_new.  Its members are private to
+ * evpool.c.  Like the PoolAlloc and PoolFree functions it uses, it is for
+ * a single thread, such as that running an event loop.  Like its pool, it
+ * is aligned to DAlignCacheLine, so storage for one from malloc might need
+ * an aligned allocator instead
+ */
+struct evpool
+  {
+    /* The layout of each record, from TailLayout */
+    struct tail_layout layout;
+    struct pool pool;
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/* Returns the context of the record whose event is Event */
+extern void * EvPoolContext(const struct evpool * Pool, struct event * Event);
+/*
+ * Releases all of the records of Pool.  Every event must have been freed
+ * with EvPoolFree, or at least deleted, first.  Pool may be initialized
+ * again afterwards
+ */
+extern void EvPoolDestroy(struct evpool * Pool);
+/* Returns the event of the record whose context is Context */
+extern struct event * EvPoolEvent(
+    const struct evpool * Pool,
+    void * Context
+  );
+/*
+ * Deletes the event of the record whose context is Context, as event_del
+ * does, and returns the record to Pool.  Context may be null
+ */
+extern void EvPoolFree(struct evpool * Pool, void * Context);
+/*
+ * Prepares Pool for contexts of ContextSize bytes, each followed by a
+ * 'struct event' of the size which libevent2 reports at run-time, with
+ * RefillCount as for PoolInit.  The event is aligned to its size's
+ * power-of-two factor, but to no more than DEvPoolEventAlign.  Returns the
+ * size of each record, or zero if Pool is null or TailLayoutEx would
+ * return zero
+ */
+extern size_t EvPoolInit(
+    struct evpool * Pool,
+    size_t ContextSize,
+    size_t RefillCount
+  );
+/*
+ * Allocates a record from Pool and assigns its event with event_assign,
+ * for Base, Fd and Events, with Callback to be called with a pointer to the
+ * context of the record as its argument.  The context is not initialized.
+ * Returns a pointer to the context, or a null pointer if the allocation or
+ * event_assign failed.  If Event is non-null, a pointer to the event is
+ * stored there, or a null pointer on failure
+ */
+extern void * EvPoolNew(
+    struct evpool * Pool,
+    struct event_base * Base,
+    evutil_socket_t Fd,
+    short Events,
+    event_callback_fn Callback,
+    struct event ** Event
+  );
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_evpool */
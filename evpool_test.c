@@ -0,0 +1,203 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A test of evpool.c, for where libevent2 is installed.  Timers are added
+ * for records from an evpool, and each timer's callback recovers its
+ * context from the running event with EvPoolContext, then checks it
+ * against the argument that libevent2 passed.  The layout of the records
+ * is checked against TailLayoutEx and DEvPoolEventAlign:
+ *
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -O2 -o evpool_test \
+ *     align.c pool.c evpool.c evpool_test.c -levent -latomic
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <event2/event.h>
+#include "align.h"
+#include "evpool.h"
+
+/* Timers added, each a millisecond later than the one before */
+#define DTestTimers 10
+
+/* The context of each record */
+struct timer
+  {
+    struct event_base * base;
+    /* Non-zero if the callback found something wrong */
+    int failed;
+    int fired;
+    unsigned long number;
+  };
+
+static void fire_timer(evutil_socket_t Fd, short Events, void * Argument);
+
+/* Aligned as a pool must be, which static storage does for it */
+static struct evpool pool;
+
+int main(void)
+  {
+    struct event_base * base;
+    struct event * event;
+    size_t event_align;
+    int failed;
+    size_t i;
+    struct tail_layout layout;
+    size_t size;
+    struct timeval timeout;
+    struct timer * timers[DTestTimers];
+
+    base = event_base_new();
+    if (!base)
+      {
+        fprintf(stderr, "evpool_test: event_base_new failed\n");
+        return EXIT_FAILURE;
+      }
+    size = EvPoolInit(&pool, sizeof (struct timer), 4);
+    event_align = LargestPowerOfTwoFactor(event_get_struct_event_size());
+    if (event_align > DEvPoolEventAlign)
+      event_align = DEvPoolEventAlign;
+    TailLayoutEx(
+        &layout,
+        sizeof (struct timer),
+        0,
+        event_get_struct_event_size(),
+        event_align
+      );
+    if (!size || size != layout.total_size)
+      {
+        fprintf(
+            stderr,
+            "evpool_test: records of %lu bytes instead of %lu\n",
+            (unsigned long) size,
+            (unsigned long) layout.total_size
+          );
+        event_base_free(base);
+        return EXIT_FAILURE;
+      }
+
+    failed = 0;
+    for (i = 0; i < DTestTimers; ++i)
+      {
+        timers[i] = EvPoolNew(&pool, base, -1, 0, fire_timer, &event);
+        if (!timers[i])
+          {
+            fprintf(stderr, "evpool_test: EvPoolNew failed\n");
+            failed = 1;
+            break;
+          }
+        timers[i]->base = base;
+        timers[i]->failed = 0;
+        timers[i]->fired = 0;
+        timers[i]->number = (unsigned long) i;
+        if (event != EvPoolEvent(&pool, timers[i]) ||
+          EvPoolContext(&pool, event) != timers[i] ||
+          (uintptr_t) event % event_align)
+          {
+            fprintf(
+                stderr,
+                "evpool_test: timer %lu has its event misplaced\n",
+                (unsigned long) i
+              );
+            failed = 1;
+          }
+        timeout.tv_sec = 0;
+        timeout.tv_usec = (long) (1000 * (i + 1));
+        if (event_add(event, &timeout))
+          {
+            fprintf(stderr, "evpool_test: event_add failed\n");
+            failed = 1;
+          }
+      }
+
+    if (!failed && event_base_dispatch(base) < 0)
+      {
+        fprintf(stderr, "evpool_test: event_base_dispatch failed\n");
+        failed = 1;
+      }
+    while (i--)
+      {
+        if (!failed && (timers[i]->failed || timers[i]->fired != 1))
+          {
+            fprintf(
+                stderr,
+                "evpool_test: timer %lu fired %d times\n",
+                timers[i]->number,
+                timers[i]->fired
+              );
+            failed = 1;
+          }
+        EvPoolFree(&pool, timers[i]);
+      }
+    EvPoolDestroy(&pool);
+    event_base_free(base);
+    if (failed)
+      return EXIT_FAILURE;
+    printf("evpool_test: ok\n");
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * The callback of each timer, whose Argument is the context of the timer's
+ * record.  The context is found again from the running event
+ */
+static void fire_timer(evutil_socket_t Fd, short Events, void * Argument)
+  {
+    struct event * event;
+    struct timer * timer;
+
+    (void) Fd;
+    timer = Argument;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    event = event_base_get_running_event(timer->base);
+#else
+    event = EvPoolEvent(&pool, timer);
+#endif
+    if (!(Events & EV_TIMEOUT) || EvPoolContext(&pool, event) != timer)
+      {
+        fprintf(
+            stderr,
+            "evpool_test: timer %lu did not find its context\n",
+            timer->number
+          );
+        timer->failed = 1;
+      }
+    ++timer->fired;
+  }
@@ -0,0 +1,585 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * Reads descriptions of structures and writes C definitions of them, with
+ * their members reordered by the layout functions, followed by static
+ * assertions so that a compiler confirms the predicted sizes and offsets.
+ * A description is a line naming the structure, a line for each member in
+ * declared order, and a line with just "end":
+ *
+ *   struct connection
+ *     2 flags char[2]
+ *     8:8:5 next struct connection *
+ *     4:4:9 count unsigned int
+ *   end
+ *
+ * Each member line has a size, optionally followed by a colon and an
+ * alignment, another colon and a weight for -c, and another colon and a
+ * group for -g, then the member's name, then its type.  A type ending with
+ * array dimensions has them placed after the name.  Other declarators,
+ * such as for pointers to functions, need a typedef.  Anything after a '#'
+ * on a line is ignored.  Options are:
+ *   -c: Favour the members with weights, as for LayoutMembersHot
+ *   -g: Separate the groups, as for LayoutMembersGrouped
+ *   -l LineSize: The cache-line size for -c and -g
+ * Otherwise, the order is found by LayoutMembers
+ */
+/* C >= C99 required for SIZE_MAX */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "align.h"
+#include "layout.h"
+
+/* The longest line of input */
+#define DLineSize 512
+/* The longest names and types */
+#define DNameSize 128
+#define DTypeSize 256
+/* How the members are ordered */
+#define DModeMinimal 0
+#define DModeHot 1
+#define DModeGrouped 2
+
+/* The text of a member, to be written out */
+struct member_text
+  {
+    char name[DNameSize];
+    char type[DTypeSize];
+  };
+
+/* The options, and storage for the members of one structure */
+struct generator
+  {
+    size_t capacity;
+    size_t count;
+    size_t line_size;
+    struct layout_member * members;
+    int mode;
+    size_t * offsets;
+    size_t * order;
+    struct member_text * texts;
+  };
+
+static int generate_file(
+    struct generator * Generator,
+    FILE * File,
+    const char * FileName
+  );
+static int generate_struct(
+    struct generator * Generator,
+    const char * Name,
+    const char * FileName,
+    unsigned long Line
+  );
+static int grow_generator(struct generator * Generator);
+static int parse_member(
+    char * Line,
+    struct layout_member * Member,
+    struct member_text * Text
+  );
+static char * skip_space(char * Text);
+static char * skip_word(char * Text);
+
+int main(int argc, char ** argv)
+  {
+    FILE * file;
+    struct generator generator;
+    int i;
+    int status;
+
+    generator.capacity = 0;
+    generator.count = 0;
+    generator.line_size = 0;
+    generator.members = NULL;
+    generator.mode = DModeMinimal;
+    generator.offsets = NULL;
+    generator.order = NULL;
+    generator.texts = NULL;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i)
+      {
+        if (!strcmp(argv[i], "-c"))
+          generator.mode = DModeHot;
+          else if (!strcmp(argv[i], "-g"))
+          generator.mode = DModeGrouped;
+          else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+          generator.line_size = strtoul(argv[++i], NULL, 10);
+          else
+          {
+            fprintf(
+                stderr,
+                "Usage: %s [-c | -g] [-l LineSize] [File...]\n",
+                argv[0]
+              );
+            return EXIT_FAILURE;
+          }
+      }
+
+    printf("#include <stddef.h>\n");
+    status = EXIT_SUCCESS;
+    if (i == argc && !generate_file(&generator, stdin, "-"))
+      status = EXIT_FAILURE;
+    for (; i < argc; ++i)
+      {
+        file = argv[i][0] == '-' && !argv[i][1] ? stdin : fopen(argv[i], "r");
+        if (!file)
+          {
+            fprintf(stderr, "%s: Could not open\n", argv[i]);
+            status = EXIT_FAILURE;
+            continue;
+          }
+        if (!generate_file(&generator, file, argv[i]))
+          status = EXIT_FAILURE;
+        if (file != stdin)
+          fclose(file);
+      }
+    free(generator.members);
+    return status;
+  }
+
+/*
+ * Reads each structure described in File and writes its definition.
+ * Returns zero if there was not enough memory, a read error or a bad
+ * description, or non-zero otherwise
+ */
+static int generate_file(
+    struct generator * Generator,
+    FILE * File,
+    const char * FileName
+  )
+  {
+    char * end;
+    int in_struct;
+    char line[DLineSize];
+    unsigned long line_number;
+    char name[DNameSize];
+    unsigned long start;
+    int status;
+    char * word;
+
+    in_struct = 0;
+    line_number = 0;
+    start = 0;
+    status = 1;
+    while (fgets(line, sizeof line, File))
+      {
+        ++line_number;
+        end = strchr(line, '\n');
+        if (!end && !feof(File))
+          {
+            fprintf(stderr, "%s:%lu: Line too long\n", FileName, line_number);
+            return 0;
+          }
+        end = strchr(line, '#');
+        if (end)
+          *end = '\0';
+        word = skip_space(line);
+        if (!*word)
+          continue;
+
+        end = skip_word(word);
+        if (!in_struct)
+          {
+            /* Expect "struct" and a name */
+            if (end - word != 6 || strncmp(word, "struct", 6))
+              {
+                fprintf(
+                    stderr,
+                    "%s:%lu: Expected struct\n",
+                    FileName,
+                    line_number
+                  );
+                return 0;
+              }
+            word = skip_space(end);
+            end = skip_word(word);
+            if (end == word ||
+              (size_t) (end - word) >= sizeof name ||
+              *skip_space(end))
+              {
+                fprintf(stderr, "%s:%lu: Bad name\n", FileName, line_number);
+                return 0;
+              }
+            memcpy(name, word, (size_t) (end - word));
+            name[end - word] = '\0';
+            Generator->count = 0;
+            in_struct = 1;
+            start = line_number;
+            continue;
+          }
+
+        if (end - word == 3 && !strncmp(word, "end", 3) && !*skip_space(end))
+          {
+            if (!generate_struct(Generator, name, FileName, start))
+              status = 0;
+            in_struct = 0;
+            continue;
+          }
+
+        if (Generator->count == Generator->capacity &&
+          !grow_generator(Generator))
+          {
+            fprintf(stderr, "%s:%lu: Out of memory\n", FileName, line_number);
+            return 0;
+          }
+        if (!parse_member(
+            word,
+            Generator->members + Generator->count,
+            Generator->texts + Generator->count
+          ))
+          {
+            fprintf(stderr, "%s:%lu: Bad member\n", FileName, line_number);
+            return 0;
+          }
+        ++Generator->count;
+      }
+
+    if (ferror(File))
+      {
+        fprintf(stderr, "%s: Read error\n", FileName);
+        return 0;
+      }
+    if (in_struct)
+      {
+        fprintf(stderr, "%s:%lu: %s: Expected end\n", FileName, start, name);
+        return 0;
+      }
+    return status;
+  }
+
+/*
+ * Used by generate_file.  Lays out the members of one structure and writes
+ * its definition and assertions.  Returns zero if the members could not be
+ * laid out, or non-zero otherwise
+ */
+static int generate_struct(
+    struct generator * Generator,
+    const char * Name,
+    const char * FileName,
+    unsigned long Line
+  )
+  {
+    const char * bracket;
+    size_t declared;
+    size_t end;
+    size_t i;
+    size_t j;
+    size_t * keys;
+    size_t offset;
+    size_t padding;
+    const struct member_text * text;
+    size_t total;
+
+    total = 0;
+    declared = 0;
+    if (Generator->count)
+      {
+        declared = LayoutMembersDeclared(
+            Generator->members,
+            Generator->count,
+            NULL
+          );
+        if (Generator->mode == DModeHot)
+          {
+            total = LayoutMembersHot(
+                Generator->members,
+                Generator->count,
+                Generator->line_size,
+                0,
+                Generator->order,
+                Generator->offsets,
+                NULL
+              );
+          }
+          else if (Generator->mode == DModeGrouped)
+          {
+            total = LayoutMembersGrouped(
+                Generator->members,
+                Generator->count,
+                Generator->line_size,
+                Generator->order,
+                Generator->offsets,
+                NULL
+              );
+          }
+          else
+          {
+            total = LayoutMembers(
+                Generator->members,
+                Generator->count,
+                Generator->order,
+                Generator->offsets,
+                NULL
+              );
+          }
+      }
+    if (!total || !declared)
+      {
+        fprintf(
+            stderr,
+            "%s:%lu: %s: Could not lay out the members\n",
+            FileName,
+            Line,
+            Name
+          );
+        return 0;
+      }
+
+    /*
+     * Members are written in order of offset.  Sorting pairs of an offset
+     * and an index into descending order gives them backwards
+     */
+    keys = Generator->order;
+    for (i = 0; i < Generator->count; ++i)
+      {
+        keys[2 * i] = Generator->offsets[i];
+        keys[2 * i + 1] = i;
+      }
+    SortSizesDescending(keys, Generator->count, 2 * sizeof *keys);
+
+    printf(
+        "\n/* %lu bytes as declared, %lu bytes reordered */\n",
+        (unsigned long) declared,
+        (unsigned long) total
+      );
+    if (Generator->mode != DModeMinimal)
+      {
+        printf(
+            "/* Storage must begin at a multiple of %lu bytes */\n",
+            (unsigned long) (Generator->line_size ?
+              Generator->line_size :
+              DLayoutCacheLine)
+          );
+      }
+    printf("struct %s\n  {\n", Name);
+    end = 0;
+    padding = 0;
+    for (i = Generator->count; i--; )
+      {
+        j = keys[2 * i + 1];
+        offset = keys[2 * i];
+        text = Generator->texts + j;
+
+        /*
+         * Fill any gap, as a compiler only pads to the real alignment of a
+         * type, which may be less than the one inferred from its size
+         */
+        if (offset > end)
+          {
+            printf(
+                "    char pad%lu[%lu];\n",
+                (unsigned long) padding++,
+                (unsigned long) (offset - end)
+              );
+          }
+        bracket = strchr(text->type, '[');
+        if (bracket)
+          {
+            printf(
+                "    %.*s %s%s;\n",
+                (int) (bracket - text->type),
+                text->type,
+                text->name,
+                bracket
+              );
+          }
+          else
+          printf("    %s %s;\n", text->type, text->name);
+        end = offset + Generator->members[j].size;
+      }
+    if (total > end)
+      {
+        printf(
+            "    char pad%lu[%lu];\n",
+            (unsigned long) padding,
+            (unsigned long) (total - end)
+          );
+      }
+    printf("  };\n");
+
+    /* An array type with a negative size is an error */
+    printf(
+        "typedef char %s_size_check[\n"
+          "    sizeof (struct %s) == %lu ? 1 : -1\n"
+          "  ];\n",
+        Name,
+        Name,
+        (unsigned long) total
+      );
+    for (i = 0; i < Generator->count; ++i)
+      {
+        printf(
+            "typedef char %s_%s_offset_check[\n"
+              "    offsetof(struct %s, %s) == %lu ? 1 : -1\n"
+              "  ];\n",
+            Name,
+            Generator->texts[i].name,
+            Name,
+            Generator->texts[i].name,
+            (unsigned long) Generator->offsets[i]
+          );
+      }
+    return 1;
+  }
+
+/*
+ * Used by generate_file.  Doubles the capacity of Generator.  Returns zero
+ * if there was not enough memory, or non-zero otherwise
+ */
+static int grow_generator(struct generator * Generator)
+  {
+    size_t capacity;
+    size_t each;
+    struct layout_member * members;
+    size_t * offsets;
+    size_t * order;
+    struct member_text * texts;
+
+    /* The order doubles as pairs of keys for sorting */
+    capacity = Generator->capacity ? 2 * Generator->capacity : 16;
+    each = sizeof *members + 3 * sizeof *offsets + sizeof *texts;
+    if (capacity > SIZE_MAX / each)
+      return 0;
+    members = malloc(capacity * each);
+    if (!members)
+      return 0;
+    offsets = (size_t *) (members + capacity);
+    order = offsets + capacity;
+    texts = (struct member_text *) (order + 2 * capacity);
+
+    /* Only the members and their texts need be kept */
+    if (Generator->count)
+      {
+        memcpy(
+            members,
+            Generator->members,
+            Generator->count * sizeof *members
+          );
+        memcpy(texts, Generator->texts, Generator->count * sizeof *texts);
+      }
+    free(Generator->members);
+    Generator->capacity = capacity;
+    Generator->members = members;
+    Generator->offsets = offsets;
+    Generator->order = order;
+    Generator->texts = texts;
+    return 1;
+  }
+
+/*
+ * Used by generate_file.  Parses a member line, which is modified.  Returns
+ * zero if it is not valid, or non-zero otherwise
+ */
+static int parse_member(
+    char * Line,
+    struct layout_member * Member,
+    struct member_text * Text
+  )
+  {
+    char * end;
+    size_t field;
+    size_t length;
+    char * name;
+    size_t * fields[4];
+    unsigned long value;
+
+    fields[0] = &Member->size;
+    fields[1] = &Member->align;
+    fields[2] = &Member->weight;
+    fields[3] = &Member->group;
+    for (field = 0; field < 4; ++field)
+      *fields[field] = 0;
+
+    /* The size, then any alignment, weight and group */
+    for (field = 0; field < 4; ++field)
+      {
+        value = strtoul(Line, &end, 10);
+        if (end == Line ||
+          *Line == '-' ||
+          value == ULONG_MAX ||
+          value > SIZE_MAX)
+          return 0;
+        *fields[field] = value;
+        Line = end;
+        if (*Line != ':')
+          break;
+        ++Line;
+      }
+    if (field == 4 || (*Line != ' ' && *Line != '\t'))
+      return 0;
+
+    name = skip_space(Line);
+    end = skip_word(name);
+    length = (size_t) (end - name);
+    if (!length || length >= sizeof Text->name)
+      return 0;
+    memcpy(Text->name, name, length);
+    Text->name[length] = '\0';
+
+    /* The type is the rest of the line, without surrounding space */
+    Line = skip_space(end);
+    length = strlen(Line);
+    while (length && strchr(" \t\r\n", Line[length - 1]))
+      --length;
+    if (!length || length >= sizeof Text->type)
+      return 0;
+    memcpy(Text->type, Line, length);
+    Text->type[length] = '\0';
+    return 1;
+  }
+
+/* Returns a pointer to the first character of Text which is not a space */
+static char * skip_space(char * Text)
+  {
+    while (*Text == ' ' || *Text == '\t' || *Text == '\r' || *Text == '\n')
+      ++Text;
+    return Text;
+  }
+
+/* Returns a pointer to the first space or terminator after a word */
+static char * skip_word(char * Text)
+  {
+    while (*Text && !strchr(" \t\r\n", *Text))
+      ++Text;
+    return Text;
+  }
@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# Simple alignment demonstration
+#
+# Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+# Web-site: https://www.synthetel.com
+# Author: Shao Miller <github@synthetel.com>
+#
+# License:
+#   You are permitted to download, modify, compile and use this
+# code, but you may not re-distribute it in either source-code nor compiled
+# form unless this entire C comment-block is reproduced and distributed intact
+# with your re-distribution, or unless you have obtained explicit permission
+# from Synthetel Corporation.
+# (This simple license will be reviewed, at some point.)
+#
+# Details:
+#   Ordering the members of a structure from largest to smallest tends to
+# maximize storage efficiency.  This is a small demonstration.
+#
+#   It is sometimes the case that you are using a library that uses an
+# opaque structure which you might like to allocate, track, and deallocate
+# on your own, perhaps combining the structure with other data to save the
+# overhead of allocations or simply to keep things together for easy
+# debugging.  If you know the size of the opaque structure, you can use
+# the TailAlignedSize function in this code to portably determine a
+# storage-size which is safely aligned for your own data as well as for the
+# opaque structure, with the latter occupying the end of that storage-size.
+#
+#   For example, libevent2 provides the 'event_get_struct_event_size'
+# function, which allows your program to know the size of a 'struct event'
+# at run-time instead of at translation-time.  With this knowledge, you
+# can determine the size you'd need to have your own contextual data with
+# a trailing 'struct event'.  If the common case for you is to have an
+# allocation for contextual data and an allocation for the libevent2 event,
+# this strategy reduces your allocations by half.
+#
+# Simple math reveals where a trailing object begins, given the head, or
+# where a header object begins, given the tail.
+#
+#
+# A test of generate.c.  It builds the generator, has it write structures
+# in each of its modes, and compiles what it writes, so that the compiler
+# checks each predicted size and offset with the assertions written with
+# them.  Members whose types are less aligned than their sizes suggest,
+# such as arrays of characters, are among them.  Run it from anywhere,
+# with CC naming a compiler other than gcc, if wanted:
+#
+#   sh generate_test.sh
+
+CC=${CC:-gcc}
+source_dir=$(dirname "$0")
+work_dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$work_dir"' EXIT
+
+$CC -ansi -pedantic -Wall -Wextra -Werror -O2 -o "$work_dir/generate" \
+  "$source_dir/align.c" "$source_dir/layout.c" "$source_dir/generate.c" ||
+  exit 1
+
+cat > "$work_dir/input.txt" <<'END'
+struct connection
+  1 c char
+  2 flags char[2]
+  8:8:5 next struct connection *
+  4:4:9 count unsigned int
+end
+struct session
+  4:4:9 count unsigned int
+  1:1:8 c char
+  2:2:7 flags char[2]
+  8:8:1 next struct session *
+  3 tag char[3]
+  2:2:6 port unsigned short
+end
+struct grouped
+  1:1:5:1 a char
+  6:2:4:1 code char[6]
+  4:4:3:2 id int
+  2:2:2:2 b char[2]
+  16:0:0:3 name char[16]
+  8:8:1:3 big double
+end
+END
+
+status=0
+for mode in "" "-c" "-c -l 32" "-g" "-g -l 32"
+do
+  # The modes are split into words on purpose
+  if ! "$work_dir/generate" $mode "$work_dir/input.txt" \
+    > "$work_dir/output.c" ||
+    ! $CC -ansi -pedantic -Wall -Werror -c -o "$work_dir/output.o" \
+      "$work_dir/output.c"
+  then
+    echo "generate_test: the output of mode \"$mode\" is wrong" >&2
+    status=1
+  fi
+done
+if [ $status -eq 0 ]
+then
+  echo "generate_test: ok"
+fi
+exit $status
@@ -0,0 +1,1079 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* C >= C99 required for SIZE_MAX */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "align.h"
+#include "layout.h"
+
+/* Used by layout_greedy, for sorting members with SortAlignmentsDescending */
+struct layout_key
+  {
+    size_t size;
+    size_t align;
+    size_t index;
+  };
+
+/* Used by LayoutMembersHot: the bytes occupied by a placed member */
+struct layout_span
+  {
+    size_t start;
+    size_t end;
+    size_t index;
+  };
+
+static size_t layout_aligns(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Aligns,
+    size_t * Alignment
+  );
+static size_t layout_best_fit(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    const size_t * Sorted,
+    size_t * Order
+  );
+static size_t layout_cold(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    const size_t * Ids,
+    size_t Count,
+    size_t * Order,
+    size_t * Offsets,
+    size_t * Alignment
+  );
+static size_t layout_end(size_t Offset, size_t Size, size_t Align);
+static size_t layout_exact(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Order
+  );
+static int layout_greedy(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Order
+  );
+static size_t layout_grouped(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Line,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_group_result * Result,
+    size_t * Scratch
+  );
+static size_t layout_hot(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Line,
+    int Flags,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_hot_result * Result,
+    size_t * Scratch
+  );
+static size_t layout_lines(
+    const struct layout_member * Members,
+    const struct layout_span * Spans,
+    size_t Count,
+    size_t Line
+  );
+static size_t layout_order(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    const size_t * Order,
+    size_t * Offsets
+  );
+static size_t layout_pack(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    const size_t * Ids,
+    size_t Count,
+    size_t Line,
+    struct layout_span * Spans,
+    size_t * SpanCount
+  );
+static size_t layout_start(
+    size_t Offset,
+    size_t Size,
+    size_t Align,
+    size_t Line
+  );
+
+/*
+ * Used by LayoutColumns and the LayoutMembers functions.  Stores the
+ * alignment of each member into Aligns and the strictest alignment into
+ * *Alignment.  Returns the lower bound for the total size, or zero if a
+ * member has a zero size or an alignment which is not a power of two, or
+ * the sizes are too large
+ */
+static size_t layout_aligns(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Aligns,
+    size_t * Alignment
+  )
+  {
+    size_t i;
+    size_t sum;
+
+    *Alignment = 1;
+    sum = 0;
+    for (i = 0; i < Count; ++i)
+      {
+        Aligns[i] = Members[i].align;
+        if (!Aligns[i])
+          Aligns[i] = LargestPowerOfTwoFactor(Members[i].size);
+        if (!Members[i].size ||
+          Aligns[i] & (Aligns[i] - 1) ||
+          sum > SIZE_MAX - Members[i].size)
+          return 0;
+        sum += Members[i].size;
+        if (Aligns[i] > *Alignment)
+          *Alignment = Aligns[i];
+      }
+    return layout_end(sum, 0, *Alignment);
+  }
+
+/*
+ * Used by LayoutMembers.  Builds an ordering by taking, at each offset, the
+ * member needing the least padding there, preferring members earlier in the
+ * Sorted ordering.  Returns the total size, or zero on overflow
+ */
+static size_t layout_best_fit(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    const size_t * Sorted,
+    size_t * Order
+  )
+  {
+    size_t best;
+    size_t best_padding;
+    size_t i;
+    size_t j;
+    size_t mask;
+    size_t offset;
+    size_t padding;
+    size_t * remaining;
+    size_t remaining_count;
+
+    /* Order doubles as the list of members yet to be placed */
+    remaining = Order;
+    memcpy(remaining, Sorted, Count * sizeof *remaining);
+    offset = 0;
+    for (remaining_count = Count; remaining_count; --remaining_count)
+      {
+        best = 0;
+        best_padding = SIZE_MAX;
+        for (i = 0; i < remaining_count; ++i)
+          {
+            mask = Aligns[remaining[i]] - 1;
+            padding = ((offset + mask) & ~mask) - offset;
+            if (padding < best_padding)
+              {
+                best = i;
+                best_padding = padding;
+                if (!padding)
+                  break;
+              }
+          }
+
+        /* Keep the rest in their sorted order, behind the placed ones */
+        j = remaining[best];
+        memmove(remaining + 1, remaining, best * sizeof *remaining);
+        *remaining++ = j;
+        offset = layout_end(offset, Members[j].size, Aligns[j]);
+        if (!offset)
+          return 0;
+      }
+    return layout_order(Members, Aligns, Count, Order, NULL);
+  }
+
+/*
+ * Used by LayoutMembersHot.  Lays out the Count members listed in Ids with
+ * LayoutMembers, as a block of their own.  The order is stored into Order
+ * as indices into Members, and the offsets into Offsets at those indices.
+ * The strictest alignment is stored into *Alignment.  Returns the size of
+ * the block, or zero if there is not enough memory
+ */
+static size_t layout_cold(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    const size_t * Ids,
+    size_t Count,
+    size_t * Order,
+    size_t * Offsets,
+    size_t * Alignment
+  )
+  {
+    size_t i;
+    struct layout_member * members;
+    size_t * offsets;
+    struct layout_result result;
+    size_t total;
+
+    members = malloc(Count * (sizeof *members + sizeof *offsets));
+    if (!members)
+      return 0;
+    offsets = (size_t *) (members + Count);
+    for (i = 0; i < Count; ++i)
+      {
+        members[i].size = Members[Ids[i]].size;
+        members[i].align = Aligns[Ids[i]];
+        members[i].weight = 0;
+        members[i].group = 0;
+      }
+    total = LayoutMembers(members, Count, Order, offsets, &result);
+    for (i = 0; total && i < Count; ++i)
+      {
+        Offsets[Ids[Order[i]]] = offsets[Order[i]];
+        Order[i] = Ids[Order[i]];
+      }
+    if (total)
+      *Alignment = result.alignment;
+    free(members);
+    return total;
+  }
+
+/*
+ * Returns the offset just past a member of Size bytes and alignment Align,
+ * placed at the lowest suitable offset from Offset, or zero on overflow
+ */
+static size_t layout_end(size_t Offset, size_t Size, size_t Align)
+  {
+    size_t mask;
+
+    mask = Align - 1;
+    if (Offset > SIZE_MAX - mask)
+      return 0;
+    Offset = (Offset + mask) & ~mask;
+    if (Offset > SIZE_MAX - Size)
+      return 0;
+    return Offset + Size;
+  }
+
+/*
+ * Used by LayoutMembers.  Finds the best ordering by working out, for every
+ * subset of the members, the least offset at which that subset can end.
+ * Placing a member can never end earlier by starting later, so the least
+ * offset for a subset comes from the least offset for the subset without
+ * one of its members.  Returns the total size, or zero on overflow or if
+ * there is not enough memory
+ */
+static size_t layout_exact(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Order
+  )
+  {
+    size_t bit;
+    size_t * ends;
+    size_t end;
+    unsigned char * lasts;
+    size_t i;
+    size_t set;
+    size_t sets;
+
+    sets = (size_t) 1 << Count;
+    ends = malloc(sets * sizeof *ends);
+    lasts = malloc(sets);
+    if (!ends || !lasts)
+      {
+        free(ends);
+        free(lasts);
+        return 0;
+      }
+
+    /* A zero offset doubles as overflow, as no member has a zero size */
+    ends[0] = 0;
+    for (set = 1; set < sets; ++set)
+      {
+        ends[set] = 0;
+        for (i = 0; i < Count; ++i)
+          {
+            bit = (size_t) 1 << i;
+            if (!(set & bit) || (set != bit && !ends[set ^ bit]))
+              continue;
+            end = layout_end(ends[set ^ bit], Members[i].size, Aligns[i]);
+            if (end && (!ends[set] || end < ends[set]))
+              {
+                ends[set] = end;
+                lasts[set] = (unsigned char) i;
+              }
+          }
+      }
+
+    /* Work backwards from the whole set */
+    set = sets - 1;
+    if (ends[set])
+      {
+        for (i = Count; i--; set ^= (size_t) 1 << lasts[set])
+          Order[i] = lasts[set];
+      }
+    end = ends[sets - 1];
+    free(ends);
+    free(lasts);
+    if (!end)
+      return 0;
+    return layout_order(Members, Aligns, Count, Order, NULL);
+  }
+
+/*
+ * Used by LayoutMembers.  Stores the indices of the members into Order, by
+ * descending alignment and then descending size.  Returns zero if there is
+ * not enough memory
+ */
+static int layout_greedy(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    size_t * Order
+  )
+  {
+    size_t i;
+    struct layout_key * keys;
+
+    if (Count > SIZE_MAX / sizeof *keys)
+      return 0;
+    keys = malloc(Count * sizeof *keys);
+    if (!keys)
+      return 0;
+    for (i = 0; i < Count; ++i)
+      {
+        keys[i].size = Members[i].size;
+        keys[i].align = Aligns[i];
+        keys[i].index = i;
+      }
+    SortAlignmentsDescending(
+        &keys->size,
+        Count,
+        sizeof *keys,
+        offsetof(struct layout_key, align)
+      );
+    for (i = 0; i < Count; ++i)
+      Order[i] = keys[i].index;
+    free(keys);
+    return 1;
+  }
+
+/*
+ * Used by LayoutMembersHot.  Counts the cache lines of Line bytes holding
+ * any part of a hot member, given Count spans in order of offset
+ */
+static size_t layout_lines(
+    const struct layout_member * Members,
+    const struct layout_span * Spans,
+    size_t Count,
+    size_t Line
+  )
+  {
+    size_t first;
+    size_t i;
+    size_t last;
+    size_t lines;
+    size_t next;
+
+    lines = 0;
+    next = 0;
+    for (i = 0; i < Count; ++i)
+      {
+        if (!Members[Spans[i].index].weight)
+          continue;
+        first = Spans[i].start / Line;
+        last = (Spans[i].end - 1) / Line;
+        if (first < next)
+          first = next;
+        if (first <= last)
+          {
+            lines += last - first + 1;
+            next = last + 1;
+          }
+      }
+    return lines;
+  }
+
+/*
+ * Places the members in the given Order, storing the offset of each into
+ * Offsets, if non-null, at that member's index.  Returns the total size,
+ * or zero on overflow
+ */
+static size_t layout_order(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    size_t Count,
+    const size_t * Order,
+    size_t * Offsets
+  )
+  {
+    size_t alignment;
+    size_t i;
+    size_t j;
+    size_t offset;
+
+    alignment = 1;
+    offset = 0;
+    for (i = 0; i < Count; ++i)
+      {
+        j = Order[i];
+        offset = layout_end(offset, Members[j].size, Aligns[j]);
+        if (!offset)
+          return 0;
+        if (Offsets)
+          Offsets[j] = offset - Members[j].size;
+        if (Aligns[j] > alignment)
+          alignment = Aligns[j];
+      }
+
+    /* Pad the end, so that an array of such structures stays aligned */
+    return layout_end(offset, 0, alignment);
+  }
+
+/*
+ * Used by LayoutMembersHot.  Places each of the Count members listed in Ids,
+ * in that order, at the lowest offset at which it overlaps none of the
+ * *SpanCount Spans, which are in order of offset, as layout_start allows.
+ * Each new span is inserted into Spans, keeping them in order.  Returns the
+ * greatest end of any span, or zero on overflow
+ */
+static size_t layout_pack(
+    const struct layout_member * Members,
+    const size_t * Aligns,
+    const size_t * Ids,
+    size_t Count,
+    size_t Line,
+    struct layout_span * Spans,
+    size_t * SpanCount
+  )
+  {
+    size_t end;
+    size_t i;
+    size_t j;
+    size_t k;
+    size_t offset;
+
+    end = *SpanCount ? Spans[*SpanCount - 1].end : 0;
+    for (i = 0; i < Count; ++i)
+      {
+        k = Ids[i];
+
+        /*
+         * Try each gap between the spans in turn: from zero before the
+         * first span, and from the end of span j - 1 before span j.  The
+         * member goes in the first gap where, placed as layout_start
+         * allows, it ends no later than span j begins, or else after the
+         * last span.  The spans do not overlap, so none before a gap ends
+         * within it
+         */
+        for (j = 0; ; ++j)
+          {
+            offset = layout_start(
+                j ? Spans[j - 1].end : 0,
+                Members[k].size,
+                Aligns[k],
+                Line
+              );
+            if (offset == SIZE_MAX)
+              return 0;
+            if (j == *SpanCount)
+              break;
+            if (Spans[j].start >= offset + Members[k].size)
+              break;
+          }
+
+        memmove(Spans + j + 1, Spans + j, (*SpanCount - j) * sizeof *Spans);
+        Spans[j].start = offset;
+        Spans[j].end = offset + Members[k].size;
+        Spans[j].index = k;
+        ++*SpanCount;
+        if (Spans[j].end > end)
+          end = Spans[j].end;
+      }
+    return end;
+  }
+
+/*
+ * Used by layout_pack.  Returns the lowest offset, from Offset, for a member
+ * of Size bytes and alignment Align.  If Line is non-zero, the member must
+ * not cross a multiple of Line or, if it is larger than Line, must begin at
+ * one.  Returns SIZE_MAX on overflow
+ */
+static size_t layout_start(
+    size_t Offset,
+    size_t Size,
+    size_t Align,
+    size_t Line
+  )
+  {
+    size_t mask;
+
+    mask = Align - 1;
+    if (Offset > SIZE_MAX - mask)
+      return SIZE_MAX;
+    Offset = (Offset + mask) & ~mask;
+
+    mask = Line - 1;
+    if (Line &&
+      Offset & mask &&
+      (Size > Line || (Offset & mask) + Size > Line))
+      {
+        if (Offset > SIZE_MAX - mask)
+          return SIZE_MAX;
+        Offset = (Offset + mask) & ~mask;
+      }
+
+    if (Offset > SIZE_MAX - Size)
+      return SIZE_MAX;
+    return Offset;
+  }
+
+size_t LayoutColumns(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Elements,
+    size_t VectorAlign,
+    size_t * Offsets,
+    struct layout_column_result * Result
+  )
+  {
+    size_t align;
+    size_t * aligns;
+    size_t alignment;
+    size_t column;
+    size_t end;
+    size_t i;
+    size_t j;
+    struct layout_key * keys;
+    size_t sum;
+
+    if (!Members ||
+      !Offsets ||
+      !Count ||
+      !Elements ||
+      VectorAlign & (VectorAlign - 1) ||
+      Count > SIZE_MAX / (sizeof *aligns + sizeof *keys))
+      return 0;
+
+    aligns = malloc(Count * (sizeof *aligns + sizeof *keys));
+    if (!aligns)
+      return 0;
+    keys = (struct layout_key *) (aligns + Count);
+    end = 0;
+    sum = 0;
+    if (layout_aligns(Members, Count, aligns, &alignment))
+      {
+        for (i = 0; i < Count; ++i)
+          {
+            keys[i].size = aligns[i] > VectorAlign ? aligns[i] : VectorAlign;
+            keys[i].index = i;
+          }
+        SortSizesDescending(&keys->size, Count, sizeof *keys);
+        alignment = keys->size;
+
+        /*
+         * Each column ends at a multiple of its alignment, which is a
+         * multiple of the next column's alignment
+         */
+        for (i = 0; i < Count; ++i)
+          {
+            align = keys[i].size;
+            j = keys[i].index;
+            Offsets[j] = end;
+            if (Elements > SIZE_MAX / Members[j].size)
+              break;
+            column = Elements * Members[j].size;
+            if (end > SIZE_MAX - column)
+              break;
+            sum += column;
+            end = layout_end(end + column, 0, align);
+            if (!end)
+              break;
+          }
+        end = i < Count ? 0 : layout_end(end, 0, alignment);
+      }
+    free(aligns);
+
+    if (end && Result)
+      {
+        Result->alignment = alignment;
+        Result->padding = end - sum;
+        Result->total_size = end;
+      }
+    return end;
+  }
+
+size_t LayoutMembers(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_result * Result
+  )
+  {
+    size_t * aligns;
+    size_t alignment;
+    size_t fit_total;
+    size_t lower_bound;
+    int method;
+    size_t * scratch;
+    size_t total;
+
+    if (!Members || !Order || !Count || Count > SIZE_MAX / 2 / sizeof *aligns)
+      return 0;
+
+    aligns = malloc(2 * Count * sizeof *aligns);
+    if (!aligns)
+      return 0;
+    scratch = aligns + Count;
+    lower_bound = layout_aligns(Members, Count, aligns, &alignment);
+
+    total = 0;
+    method = DLayoutGreedy;
+    if (lower_bound && layout_greedy(Members, aligns, Count, Order))
+      total = layout_order(Members, aligns, Count, Order, NULL);
+
+    /* Try filling padding, unless there is none to fill */
+    if (total && total != lower_bound)
+      {
+        fit_total = layout_best_fit(Members, aligns, Count, Order, scratch);
+        if (fit_total && fit_total < total)
+          {
+            memcpy(Order, scratch, Count * sizeof *Order);
+            total = fit_total;
+          }
+      }
+
+    /* Search exhaustively, if it might help and would not take too long */
+    if (total && total != lower_bound && Count <= DLayoutExactLimit)
+      {
+        fit_total = layout_exact(Members, aligns, Count, scratch);
+        if (fit_total)
+          {
+            memcpy(Order, scratch, Count * sizeof *Order);
+            total = fit_total;
+            method = DLayoutExact;
+          }
+      }
+
+    if (total && Offsets)
+      layout_order(Members, aligns, Count, Order, Offsets);
+    free(aligns);
+
+    if (total && Result)
+      {
+        Result->alignment = alignment;
+        Result->lower_bound = lower_bound;
+        Result->method = method;
+        Result->total_size = total;
+      }
+    return total;
+  }
+
+size_t LayoutMembersDeclared(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Offsets
+  )
+  {
+    size_t * aligns;
+    size_t alignment;
+    size_t i;
+    size_t * order;
+    size_t total;
+
+    if (!Members || !Count || Count > SIZE_MAX / 2 / sizeof *aligns)
+      return 0;
+
+    aligns = malloc(2 * Count * sizeof *aligns);
+    if (!aligns)
+      return 0;
+    order = aligns + Count;
+    for (i = 0; i < Count; ++i)
+      order[i] = i;
+    total = 0;
+    if (layout_aligns(Members, Count, aligns, &alignment))
+      total = layout_order(Members, aligns, Count, order, Offsets);
+    free(aligns);
+    return total;
+  }
+
+/*
+ * Used by LayoutMembersGrouped, which has checked the parameters and
+ * provided Scratch, with room for two arrays of Count size_t objects,
+ * Count keys and Count members
+ */
+static size_t layout_grouped(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Line,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_group_result * Result,
+    size_t * Scratch
+  )
+  {
+    size_t alignment;
+    size_t block;
+    size_t block_align;
+    size_t end;
+    size_t first;
+    size_t groups;
+    size_t i;
+    size_t j;
+    struct layout_key * keys;
+    struct tail_layout layout;
+    struct layout_member * members;
+    size_t n;
+    size_t offset;
+    size_t * offsets;
+    size_t * order;
+    struct layout_result result;
+    size_t sum;
+
+    offsets = Scratch;
+    order = offsets + Count;
+    keys = (struct layout_key *) (order + Count);
+    members = (struct layout_member *) (keys + Count);
+
+    /* Gather each group together */
+    for (i = 0; i < Count; ++i)
+      {
+        keys[i].size = Members[i].group;
+        keys[i].index = i;
+      }
+    SortSizesDescending(&keys->size, Count, sizeof *keys);
+
+    alignment = Line;
+    end = 0;
+    groups = 0;
+    sum = 0;
+    for (first = 0; first < Count; first += n)
+      {
+        for (n = 0; first + n < Count; ++n)
+          {
+            j = keys[first + n].index;
+            if (Members[j].group != Members[keys[first].index].group)
+              break;
+            members[n] = Members[j];
+            if (sum > SIZE_MAX - Members[j].size)
+              return 0;
+            sum += Members[j].size;
+          }
+
+        /* Lay out the group, then pad it to whole lines */
+        block = LayoutMembers(members, n, order, offsets, &result);
+        if (!block)
+          return 0;
+        block_align = result.alignment > Line ? result.alignment : Line;
+        block = layout_end(block, 0, block_align);
+        if (!block)
+          return 0;
+
+        /* Append it as the tail of the blocks before it */
+        offset = 0;
+        if (end)
+          {
+            end = TailLayoutEx(&layout, end, Line, block, block_align);
+            offset = layout.tail_offset;
+          }
+          else
+          end = block;
+        if (!end)
+          return 0;
+        if (block_align > alignment)
+          alignment = block_align;
+
+        for (i = 0; i < n; ++i)
+          {
+            j = keys[first + order[i]].index;
+            Order[first + i] = j;
+            if (Offsets)
+              Offsets[j] = offset + offsets[order[i]];
+          }
+        ++groups;
+      }
+    end = layout_end(end, 0, alignment);
+    if (!end)
+      return 0;
+
+    if (Result)
+      {
+        Result->alignment = alignment;
+        Result->groups = groups;
+        Result->lines = end / Line;
+        Result->padding = end - sum;
+        Result->total_size = end;
+      }
+    return end;
+  }
+
+/*
+ * Used by LayoutMembersHot, which has checked the parameters and provided
+ * Scratch, with room for three arrays of Count size_t objects, Count spans
+ * and Count keys
+ */
+static size_t layout_hot(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Line,
+    int Flags,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_hot_result * Result,
+    size_t * Scratch
+  )
+  {
+    size_t * aligns;
+    size_t alignment;
+    size_t cold_align;
+    size_t cold_count;
+    size_t cold_offset;
+    size_t cold_size;
+    size_t end;
+    size_t hot_align;
+    size_t hot_count;
+    size_t hot_size;
+    size_t i;
+    size_t * ids;
+    struct layout_key * keys;
+    size_t * offsets;
+    size_t span_count;
+    struct layout_span * spans;
+    size_t total;
+
+    aligns = Scratch;
+    ids = aligns + Count;
+    offsets = ids + Count;
+    spans = (struct layout_span *) (offsets + Count);
+    keys = (struct layout_key *) (spans + Count);
+    if (!layout_aligns(Members, Count, aligns, &alignment))
+      return 0;
+    if (!layout_greedy(Members, aligns, Count, offsets))
+      return 0;
+
+    /*
+     * List the hot members, heaviest first, and then the cold ones.  The
+     * weights are sorted stably, so ties keep the greedy order
+     */
+    hot_count = 0;
+    for (i = 0; i < Count; ++i)
+      {
+        if (!Members[offsets[i]].weight)
+          continue;
+        keys[hot_count].size = Members[offsets[i]].weight;
+        keys[hot_count].index = offsets[i];
+        ++hot_count;
+      }
+    SortSizesDescending(&keys->size, hot_count, sizeof *keys);
+    for (i = 0; i < hot_count; ++i)
+      ids[i] = keys[i].index;
+    for ((cold_count = 0), (i = 0); i < Count; ++i)
+      {
+        if (!Members[offsets[i]].weight)
+          ids[hot_count + cold_count++] = offsets[i];
+      }
+
+    /* The hot members' block */
+    hot_align = 1;
+    for (i = 0; i < hot_count; ++i)
+      {
+        if (aligns[ids[i]] > hot_align)
+          hot_align = aligns[ids[i]];
+      }
+    span_count = 0;
+    end = layout_pack(
+        Members,
+        aligns,
+        ids,
+        hot_count,
+        Line,
+        spans,
+        &span_count
+      );
+    if (hot_count && !end)
+      return 0;
+
+    cold_offset = 0;
+    if (!(Flags & DLayoutSplit) || !hot_count || !cold_count)
+      {
+        /* Cold members go wherever they fit, crossing lines as they please */
+        end = layout_pack(
+            Members,
+            aligns,
+            ids + hot_count,
+            cold_count,
+            0,
+            spans,
+            &span_count
+          );
+        total = end ? layout_end(end, 0, alignment) : 0;
+        if (!total)
+          return 0;
+        hot_size = total;
+      }
+      else
+      {
+        /* The cold members' block is the tail */
+        hot_size = layout_end(end, 0, hot_align);
+        cold_size = layout_cold(
+            Members,
+            aligns,
+            ids + hot_count,
+            cold_count,
+            Order + hot_count,
+            offsets,
+            &cold_align
+          );
+        if (!hot_size || !cold_size)
+          return 0;
+        cold_offset = TailOffsetEx(hot_size, hot_align, cold_size, cold_align);
+        if (!cold_offset)
+          return 0;
+        total = cold_offset + cold_size;
+        for (i = hot_count; i < Count; ++i)
+          offsets[Order[i]] += cold_offset;
+      }
+
+    /* The spans are in order of offset */
+    for (i = 0; i < span_count; ++i)
+      {
+        Order[i] = spans[i].index;
+        offsets[spans[i].index] = spans[i].start;
+      }
+
+    if (Offsets)
+      memcpy(Offsets, offsets, Count * sizeof *Offsets);
+    if (Result)
+      {
+        Result->alignment = alignment;
+        Result->cold_offset = cold_offset;
+        Result->hot_lines = layout_lines(Members, spans, span_count, Line);
+        Result->hot_size = hot_size;
+        Result->total_size = total;
+      }
+    return total;
+  }
+
+size_t LayoutMembersGrouped(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t LineSize,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_group_result * Result
+  )
+  {
+    size_t each;
+    size_t * scratch;
+    size_t total;
+
+    if (!LineSize)
+      LineSize = DLayoutCacheLine;
+    if (!Members || !Order || !Count || LineSize & (LineSize - 1))
+      return 0;
+
+    each = 2 * sizeof *scratch +
+      sizeof (struct layout_key) +
+      sizeof (struct layout_member);
+    if (Count > SIZE_MAX / each)
+      return 0;
+    scratch = malloc(Count * each);
+    if (!scratch)
+      return 0;
+    total = layout_grouped(
+        Members,
+        Count,
+        LineSize,
+        Order,
+        Offsets,
+        Result,
+        scratch
+      );
+    free(scratch);
+    return total;
+  }
+
+size_t LayoutMembersHot(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t LineSize,
+    int Flags,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_hot_result * Result
+  )
+  {
+    size_t each;
+    size_t * scratch;
+    size_t total;
+
+    if (!LineSize)
+      LineSize = DLayoutCacheLine;
+    if (!Members || !Order || !Count || LineSize & (LineSize - 1))
+      return 0;
+
+    each = 3 * sizeof *scratch +
+      sizeof (struct layout_span) +
+      sizeof (struct layout_key);
+    if (Count > SIZE_MAX / each)
+      return 0;
+    scratch = malloc(Count * each);
+    if (!scratch)
+      return 0;
+    total = layout_hot(
+        Members,
+        Count,
+        LineSize,
+        Flags,
+        Order,
+        Offsets,
+        Result,
+        scratch
+      );
+    free(scratch);
+    return total;
+  }
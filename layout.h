@@ -0,0 +1,252 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_layout
+#define DIncluded_layout 1
+#include <stddef.h>
+/* The cache-line size for LayoutMembersHot, if it is not told otherwise */
+#define DLayoutCacheLine 64
+/* The most members for which LayoutMembers will search exhaustively */
+#define DLayoutExactLimit 16
+/* Methods reported by LayoutMembers */
+#define DLayoutGreedy 1
+#define DLayoutExact 2
+/* Flags for LayoutMembersHot */
+#define DLayoutSplit 1
+
+/* A member of a structure, as for the size_desc structure of test.c */
+struct layout_member
+  {
+    size_t size;
+    /*
+     * A power of two, such as an alignof result.  If zero, the alignment is
+     * taken to be the LargestPowerOfTwoFactor of the size
+     */
+    size_t align;
+    /*
+     * How often the member is accessed, relative to the others, for
+     * LayoutMembersHot.  Zero for a cold member.  Ignored by LayoutMembers
+     */
+    size_t weight;
+    /*
+     * The group of threads writing to the member, for LayoutMembersGrouped.
+     * Ignored by the other layout functions
+     */
+    size_t group;
+  };
+
+/* Describes the result of LayoutColumns */
+struct layout_column_result
+  {
+    /* The strictest alignment of any column */
+    size_t alignment;
+    /* Bytes not occupied by any element */
+    size_t padding;
+    /* The size of the storage, a multiple of the alignment */
+    size_t total_size;
+  };
+
+/* Describes the result of LayoutMembersGrouped */
+struct layout_group_result
+  {
+    /* The strictest alignment of any member, or the line size if greater */
+    size_t alignment;
+    /* The number of distinct groups */
+    size_t groups;
+    /* Cache lines in the total size */
+    size_t lines;
+    /* Bytes not occupied by any member */
+    size_t padding;
+    /* The size of the structure, including any padding at the end */
+    size_t total_size;
+  };
+
+/* Describes the result of LayoutMembers */
+struct layout_result
+  {
+    /* The strictest alignment of any member */
+    size_t alignment;
+    /*
+     * No ordering could result in a total size less than this.  The total
+     * size less this is how far the result might be from the best
+     */
+    size_t lower_bound;
+    /* DLayoutExact or DLayoutGreedy, for how the ordering was found */
+    int method;
+    /* The size of the structure, including any padding at the end */
+    size_t total_size;
+  };
+
+/* Describes the result of LayoutMembersHot */
+struct layout_hot_result
+  {
+    /* The strictest alignment of any member */
+    size_t alignment;
+    /*
+     * The offset of the block of cold members, if they were split from the
+     * hot members, or zero
+     */
+    size_t cold_offset;
+    /*
+     * Cache lines holding any part of a hot member, if the storage begins
+     * at a multiple of the cache-line size
+     */
+    size_t hot_lines;
+    /* The size of the hot members' block, or the total size if not split */
+    size_t hot_size;
+    /* The size of the structure, including any padding at the end */
+    size_t total_size;
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * Lays out a structure of arrays in one block of storage: a column of
+ * Elements elements for each of the Count members, each element having the
+ * member's size.  Each column begins at a multiple of the member's
+ * alignment, or of VectorAlign if greater, such as a SIMD register width of
+ * 16, 32 or 64, so that vector loops can use aligned loads.  The end of each
+ * column is padded up to that alignment too, so that such a loop can load
+ * whole vectors past the last element without reaching the next column.
+ * Columns are placed in descending order of alignment, so no other padding
+ * is needed.  The offset of each column is stored into Offsets at that
+ * member's index.  The storage must begin at a multiple of the strictest
+ * alignment.  VectorAlign must be a power of two, or zero for none.
+ *   If Result is non-null, it is filled in.  Returns the total size, or zero
+ * if Members or Offsets is null, Count or Elements is zero, any member has a
+ * zero size or an alignment which is not a power of two, VectorAlign is not
+ * a power of two, the sizes are too large, or there is not enough memory
+ */
+extern size_t LayoutColumns(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Elements,
+    size_t VectorAlign,
+    size_t * Offsets,
+    struct layout_column_result * Result
+  );
+/*
+ * Finds an ordering of the Count members which minimizes the total size of
+ * a structure having them, where each member is placed at the lowest offset
+ * satisfying its alignment after the ones before it, and the total size is
+ * a multiple of the strictest alignment.  For each position i, the index of
+ * the member placed there is stored into Order[i].  If Offsets is non-null,
+ * the offset of each member is stored into Offsets at that member's index.
+ * If Result is non-null, it is filled in.
+ *   A greedy ordering by alignment and then by size is tried first, along
+ * with a best-fit ordering which fills padding with smaller members.  If
+ * neither reaches the lower bound and there are no more than
+ * DLayoutExactLimit members, an exhaustive search finds the best ordering.
+ *   Returns the total size, or zero if Members or Order is null, Count is
+ * zero, any member has a zero size or an alignment which is not a power of
+ * two, the sizes are too large, or there is not enough memory
+ */
+extern size_t LayoutMembers(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_result * Result
+  );
+/*
+ * Places the Count members in the order given, each at the lowest offset
+ * satisfying its alignment after the ones before it, as a compiler would,
+ * with the total size a multiple of the strictest alignment.  This is the
+ * size to compare the result of LayoutMembers with.  If Offsets is
+ * non-null, the offset of each member is stored into it.  Returns the total
+ * size, or zero in the same cases as LayoutMembers
+ */
+extern size_t LayoutMembersDeclared(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t * Offsets
+  );
+/*
+ * As LayoutMembers, but guaranteeing that members of different groups never
+ * share a cache line of LineSize bytes, such as the destructive interference
+ * size, so that threads writing to different groups do not contend for
+ * lines.  LineSize must be a power of two, or zero for DLayoutCacheLine.
+ *   The members of each group are laid out by LayoutMembers as a block,
+ * which is padded to a whole number of lines.  Then the blocks are placed
+ * one after another, in descending order of group, each as the tail of the
+ * blocks before it, with TailLayoutEx.  The storage must begin at a multiple
+ * of LineSize for the guarantee to hold, and the total size is a multiple of
+ * LineSize, so that neighbouring storage does not share lines either.
+ *   If Result is non-null, it is filled in.  Returns the total size, or zero
+ * in the same cases as LayoutMembers, or if LineSize is not a power of two
+ */
+extern size_t LayoutMembersGrouped(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t LineSize,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_group_result * Result
+  );
+/*
+ * As LayoutMembers, but favouring the hot members, which have a non-zero
+ * weight.  Hot members are placed first, heaviest first, each at the lowest
+ * offset at which it does not cross a multiple of LineSize, or at a multiple
+ * of LineSize if it is larger than that.  LineSize must be a power of two,
+ * or zero for DLayoutCacheLine.
+ *   Normally, cold members are then placed at the lowest offsets available,
+ * which might be between hot members.  If Flags includes DLayoutSplit, the
+ * cold members are instead laid out by LayoutMembers as a separate block,
+ * which is the tail of the storage, as for TailAlignedSizeEx, with the hot
+ * members' block as the head.  Either block could then be allocated apart
+ * from the other, using the hot_size, cold_offset and total_size of Result.
+ *   If Result is non-null, it is filled in.  Returns the total size, or zero
+ * in the same cases as LayoutMembers, or if LineSize is not a power of two
+ */
+extern size_t LayoutMembersHot(
+    const struct layout_member * Members,
+    size_t Count,
+    size_t LineSize,
+    int Flags,
+    size_t * Order,
+    size_t * Offsets,
+    struct layout_hot_result * Result
+  );
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_layout */
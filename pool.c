@@ -0,0 +1,733 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* Placing slabs on nodes needs the POSIX and Linux extensions of libc */
+#ifdef __linux__
+#define _DEFAULT_SOURCE 1
+#endif
+/* C >= C99 required for SIZE_MAX */
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "align.h"
+#include "pool.h"
+
+/*
+ * Slabs are mapped and placed on nodes with the system calls that libnuma
+ * wraps, so that it is not needed.  The constants are from numaif.h
+ */
+#if defined(SYS_get_mempolicy) && defined(SYS_getcpu) && defined(SYS_mbind)
+#define DPoolNuma 1
+#define DPoolMpolPreferred 1
+#define DPoolMpolFMemsAllowed 4
+/* Enough for the most nodes that Linux supports */
+#define DPoolNodeMaskWords (1024 / (sizeof (unsigned long) * CHAR_BIT))
+#endif
+
+/*
+ * Atomic operations for sharing a pool between caches.  Without them,
+ * the caches of a pool must all be used by the same thread.  A depot is
+ * two words, so some targets need libatomic for the operations on it
+ */
+#if defined(__GNUC__) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7) || defined(__clang__))
+#define DPoolCompareExchange(Object, Expected, Desired) \
+  __atomic_compare_exchange_n( \
+      (Object), \
+      (Expected), \
+      (Desired), \
+      0, \
+      __ATOMIC_ACQ_REL, \
+      __ATOMIC_ACQUIRE \
+    )
+#define DPoolCompareExchangeDepot(Object, Expected, Desired) \
+  __atomic_compare_exchange( \
+      (Object), \
+      (Expected), \
+      (Desired), \
+      0, \
+      __ATOMIC_ACQ_REL, \
+      __ATOMIC_ACQUIRE \
+    )
+#define DPoolFetchAdd(Object, Value) \
+  __atomic_fetch_add((Object), (Value), __ATOMIC_RELAXED)
+#define DPoolFetchSub(Object, Value) \
+  __atomic_fetch_sub((Object), (Value), __ATOMIC_RELAXED)
+#define DPoolLoad(Object) __atomic_load_n((Object), __ATOMIC_RELAXED)
+#define DPoolLoadDepot(Object, Value) \
+  __atomic_load((Object), (Value), __ATOMIC_ACQUIRE)
+#define DPoolStore(Object, Value) \
+  __atomic_store_n((Object), (Value), __ATOMIC_RELAXED)
+#else
+#define DPoolCompareExchange(Object, Expected, Desired) \
+  (*(Object) == *(Expected) ? \
+    (*(Object) = (Desired), 1) : \
+    (*(Expected) = *(Object), 0))
+#define DPoolCompareExchangeDepot(Object, Expected, Desired) \
+  ((Object)->batches == (Expected)->batches && \
+    (Object)->generation == (Expected)->generation ? \
+    (*(Object) = *(Desired), 1) : \
+    (*(Expected) = *(Object), 0))
+#define DPoolFetchAdd(Object, Value) (*(Object) += (Value))
+#define DPoolFetchSub(Object, Value) (*(Object) -= (Value))
+#define DPoolLoad(Object) (*(Object))
+#define DPoolLoadDepot(Object, Value) (*(Value) = *(Object))
+#define DPoolStore(Object, Value) (*(Object) = (Value))
+#endif
+
+/*
+ * The first record of a batch.  The first member overlaps the link of a
+ * free record, so the batch is also an ordinary list of free records
+ */
+struct pool_batch
+  {
+    void * next;
+    struct pool_batch * next_batch;
+    /* Records in this batch */
+    size_t count;
+  };
+
+/* The first slot of a slab, for linking it to the others */
+struct pool_slab
+  {
+    void * next;
+    /* Bytes mapped for the slab, or zero if it came from malloc */
+    size_t size;
+  };
+
+static void pool_cache_count(struct pool_cache * Cache);
+static void pool_cache_refill(struct pool_cache * Cache);
+static void pool_cache_spill(struct pool_cache * Cache);
+#ifdef DPoolNuma
+static void * pool_map(size_t Size, int Node, int * Placed);
+#endif
+static struct pool_node * pool_node(struct pool * Pool, int Node);
+static int pool_numa(void);
+static struct pool_batch * pool_pop_batch(struct pool_node * Node);
+static void pool_push_batch(
+    struct pool_node * Node,
+    struct pool_batch * Batch
+  );
+static size_t pool_refill(struct pool * Pool, size_t Count);
+static void * pool_slab(
+    struct pool * Pool,
+    size_t * Count,
+    void * Next,
+    int Node
+  );
+
+void * PoolAlloc(struct pool * Pool, void ** Tail)
+  {
+    char * head;
+
+    if (!Pool->free_list)
+      pool_refill(Pool, Pool->refill_count);
+
+    head = Pool->free_list;
+    if (head)
+      {
+        Pool->free_list = *(void **) head;
+        --Pool->stats.counts.free_count;
+        if (++Pool->stats.counts.in_use > Pool->stats.counts.high_water)
+          Pool->stats.counts.high_water = Pool->stats.counts.in_use;
+      }
+    if (Tail)
+      *Tail = head ? TailFromHead(head, &Pool->layout) : NULL;
+    return head;
+  }
+
+void * PoolCacheAlloc(struct pool_cache * Cache, void ** Tail)
+  {
+    char * head;
+
+    if (!Cache->free_list)
+      pool_cache_refill(Cache);
+
+    head = Cache->free_list;
+    if (head)
+      {
+        Cache->free_list = *(void **) head;
+        --Cache->free_count;
+        ++Cache->in_use;
+      }
+    if (Tail)
+      *Tail = head ? TailFromHead(head, &Cache->pool->layout) : NULL;
+    return head;
+  }
+
+/*
+ * Used by pool_cache_refill and pool_cache_spill.  Adds the records counted
+ * by Cache to the counters of its pool
+ */
+static void pool_cache_count(struct pool_cache * Cache)
+  {
+    size_t high_water;
+    size_t in_use;
+    struct pool_stats * stats;
+
+    if (!Cache->in_use)
+      return;
+    stats = &Cache->pool->stats.counts;
+    in_use = Cache->in_use;
+    Cache->in_use = 0;
+    in_use += DPoolFetchAdd(&stats->in_use, in_use);
+
+    /*
+     * Records freed through this cache might not yet have been counted by
+     * the caches which allocated them, so the total might be below zero
+     */
+    if (in_use > SIZE_MAX / 2)
+      return;
+    high_water = DPoolLoad(&stats->high_water);
+    while (in_use > high_water)
+      {
+        if (DPoolCompareExchange(&stats->high_water, &high_water, in_use))
+          break;
+      }
+  }
+
+void PoolCacheFlush(struct pool_cache * Cache)
+  {
+    /* Twice, for the free list and then for the spare batch */
+    pool_cache_spill(Cache);
+    pool_cache_spill(Cache);
+  }
+
+void PoolCacheFree(struct pool_cache * Cache, void * Head)
+  {
+    if (!Head)
+      return;
+    if (Cache->free_count >= Cache->pool->refill_count)
+      pool_cache_spill(Cache);
+    *(void **) Head = Cache->free_list;
+    Cache->free_list = Head;
+    ++Cache->free_count;
+    --Cache->in_use;
+  }
+
+void PoolCacheInit(struct pool_cache * Cache, struct pool * Pool)
+  {
+    PoolCacheInitNode(Cache, Pool, DPoolAnyNode);
+  }
+
+void PoolCacheInitNode(
+    struct pool_cache * Cache,
+    struct pool * Pool,
+    int Node
+  )
+  {
+    Cache->free_list = NULL;
+    Cache->free_count = 0;
+    Cache->in_use = 0;
+    Cache->node = Node < 0 ? PoolCurrentNode() : Node;
+    Cache->pool = Pool;
+    Cache->spare = NULL;
+  }
+
+/*
+ * Used by PoolCacheAlloc.  Fills the empty free list of Cache with the
+ * spare batch, else with a batch from the shared pool, else with a new
+ * slab, after counting the records of Cache in the pool
+ */
+static void pool_cache_refill(struct pool_cache * Cache)
+  {
+    struct pool_batch * batch;
+    size_t count;
+    struct pool * pool;
+
+    pool_cache_count(Cache);
+    pool = Cache->pool;
+    batch = Cache->spare;
+    if (batch)
+      Cache->spare = NULL;
+      else
+      batch = pool_pop_batch(pool_node(pool, Cache->node));
+
+    if (batch)
+      {
+        Cache->free_list = batch;
+        Cache->free_count = batch->count;
+        return;
+      }
+
+    count = pool->refill_count;
+    Cache->free_list = pool_slab(pool, &count, NULL, Cache->node);
+    if (Cache->free_list)
+      Cache->free_count = count;
+  }
+
+/*
+ * Used by PoolCacheFlush and PoolCacheFree.  Counts the records of Cache
+ * in the pool, returns the spare batch of Cache, if any, to the shared
+ * pool, then makes the free list the spare
+ */
+static void pool_cache_spill(struct pool_cache * Cache)
+  {
+    struct pool_batch * batch;
+    struct pool_node * node;
+
+    pool_cache_count(Cache);
+    batch = Cache->spare;
+    if (batch)
+      {
+        node = pool_node(Cache->pool, Cache->node);
+        DPoolFetchAdd(&node->stats.depot_count, batch->count);
+        pool_push_batch(node, batch);
+      }
+
+    batch = Cache->free_list;
+    if (batch)
+      batch->count = Cache->free_count;
+    Cache->spare = batch;
+    Cache->free_list = NULL;
+    Cache->free_count = 0;
+  }
+
+int PoolCurrentNode(void)
+  {
+#ifdef DPoolNuma
+    unsigned int cpu;
+    unsigned int node;
+
+    if (!syscall(SYS_getcpu, &cpu, &node, NULL) && node <= INT_MAX)
+      return (int) node;
+#endif
+    return DPoolAnyNode;
+  }
+
+void PoolDestroy(struct pool * Pool)
+  {
+    size_t i;
+    void * next;
+    struct pool_node * node;
+    struct pool_slab * slab;
+
+    for (slab = Pool->slabs; slab; slab = next)
+      {
+        next = slab->next;
+#ifdef DPoolNuma
+        if (slab->size)
+          munmap(slab, slab->size);
+          else
+#endif
+          free(slab);
+      }
+    for (i = 0; i < DPoolMaxNodes; ++i)
+      {
+        node = pool_node(Pool, (int) i);
+        node->depot.batches = NULL;
+        node->depot.generation = 0;
+        node->stats.depot_count = 0;
+        node->stats.placed_count = 0;
+        node->stats.slab_count = 0;
+      }
+    Pool->free_list = NULL;
+    Pool->slabs = NULL;
+    Pool->stats.counts.free_count = 0;
+    Pool->stats.counts.in_use = 0;
+    Pool->stats.counts.slab_count = 0;
+  }
+
+void PoolFree(struct pool * Pool, void * Head)
+  {
+    if (!Head)
+      return;
+    *(void **) Head = Pool->free_list;
+    Pool->free_list = Head;
+    ++Pool->stats.counts.free_count;
+    --Pool->stats.counts.in_use;
+  }
+
+void PoolGetLayout(const struct pool * Pool, struct tail_layout * Layout)
+  {
+    *Layout = Pool->layout;
+  }
+
+void PoolGetNodeStats(
+    const struct pool * Pool,
+    int Node,
+    struct pool_node_stats * Stats
+  )
+  {
+    const struct pool_node * node;
+
+    node = pool_node((struct pool *) Pool, Node);
+    Stats->depot_count = DPoolLoad(&node->stats.depot_count);
+    Stats->placed_count = DPoolLoad(&node->stats.placed_count);
+    Stats->slab_count = DPoolLoad(&node->stats.slab_count);
+  }
+
+void PoolGetStats(const struct pool * Pool, struct pool_stats * Stats)
+  {
+    int i;
+
+    /* Caches might be updating some of these */
+    Stats->depot_count = 0;
+    for (i = 0; i < DPoolMaxNodes; ++i)
+      {
+        Stats->depot_count += DPoolLoad(
+            &pool_node((struct pool *) Pool, i)->stats.depot_count
+          );
+      }
+    Stats->free_count = Pool->stats.counts.free_count;
+    Stats->high_water = DPoolLoad(&Pool->stats.counts.high_water);
+    Stats->in_use = DPoolLoad(&Pool->stats.counts.in_use);
+    /* Below zero, for now, as pool_cache_count describes */
+    if (Stats->in_use > SIZE_MAX / 2)
+      Stats->in_use = 0;
+    Stats->slab_count = DPoolLoad(&Pool->stats.counts.slab_count);
+  }
+
+size_t PoolInit(
+    struct pool * Pool,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t RefillCount
+  )
+  {
+    return PoolInitEx(Pool, HeadSize, 0, TailSize, 0, RefillCount);
+  }
+
+size_t PoolInitEx(
+    struct pool * Pool,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    size_t RefillCount
+  )
+  {
+    size_t factor;
+    size_t i;
+    struct pool_node * node;
+    size_t stride;
+
+    if (!Pool || !TailLayoutEx(
+        &Pool->layout,
+        HeadSize,
+        HeadAlign,
+        TailSize,
+        TailAlign
+      ))
+      return 0;
+
+    /*
+     * Each free record might begin a batch, so the stride must be large
+     * enough and aligned enough for a batch.  The record size is a multiple
+     * of its alignment, a power of two, so rounding it up to a multiple of
+     * the batch's factor keeps every record aligned
+     */
+    stride = Pool->layout.total_size;
+    if (stride < sizeof (struct pool_batch))
+      stride = sizeof (struct pool_batch);
+    factor = LargestPowerOfTwoFactor(sizeof (struct pool_batch));
+    if (SIZE_MAX - stride < factor - 1)
+      return 0;
+    stride = (stride + factor - 1) & ~(factor - 1);
+
+    Pool->free_list = NULL;
+    Pool->node = DPoolAnyNode;
+    for (i = 0; i < DPoolMaxNodes; ++i)
+      {
+        node = pool_node(Pool, (int) i);
+        node->depot.batches = NULL;
+        node->depot.generation = 0;
+        node->stats.depot_count = 0;
+        node->stats.placed_count = 0;
+        node->stats.slab_count = 0;
+      }
+    Pool->numa = pool_numa();
+    Pool->refill_count = RefillCount ? RefillCount : DPoolRefillCount;
+    Pool->slabs = NULL;
+    Pool->stats.counts.depot_count = 0;
+    Pool->stats.counts.free_count = 0;
+    Pool->stats.counts.high_water = 0;
+    Pool->stats.counts.in_use = 0;
+    Pool->stats.counts.slab_count = 0;
+    Pool->stride = stride;
+    return Pool->layout.total_size;
+  }
+
+#ifdef DPoolNuma
+/*
+ * Used by pool_slab.  Maps Size bytes, asking that they be placed on Node,
+ * and stores whether the operating system agreed into Placed.  Returns the
+ * storage, or a null pointer if mapping failed
+ */
+static void * pool_map(size_t Size, int Node, int * Placed)
+  {
+    size_t bits;
+    unsigned long mask[DPoolNodeMaskWords];
+    void * storage;
+
+    storage = mmap(
+        NULL,
+        Size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0
+      );
+    if (storage == MAP_FAILED)
+      return NULL;
+
+    /* The pages are not yet touched, so the policy applies to them all */
+    *Placed = 0;
+    bits = sizeof *mask * CHAR_BIT;
+    if ((size_t) Node < DPoolNodeMaskWords * bits)
+      {
+        memset(mask, 0, sizeof mask);
+        mask[Node / bits] = 1UL << Node % bits;
+        /* The kernel reads one bit fewer than it is told to */
+        *Placed = !syscall(
+            SYS_mbind,
+            storage,
+            (unsigned long) Size,
+            DPoolMpolPreferred,
+            mask,
+            (unsigned long) (DPoolNodeMaskWords * bits + 1),
+            0UL
+          );
+      }
+    return storage;
+  }
+#endif
+
+/*
+ * Returns the part of Pool for Node, sharing parts between the nodes
+ * beyond DPoolMaxNodes and those whose node is unknown
+ */
+static struct pool_node * pool_node(struct pool * Pool, int Node)
+  {
+    return &Pool->nodes[Node < 0 ? 0 : Node % DPoolMaxNodes].node;
+  }
+
+/*
+ * Used by PoolInitEx.  Returns non-zero if the system has more than one node
+ * of memory, so that slabs are worth mapping and placing on nodes.
+ * Otherwise they come from malloc, as they do without NUMA support
+ */
+static int pool_numa(void)
+  {
+#ifdef DPoolNuma
+    size_t count;
+    size_t i;
+    unsigned long mask[DPoolNodeMaskWords];
+    int mode;
+    unsigned long word;
+
+    if (syscall(
+        SYS_get_mempolicy,
+        &mode,
+        mask,
+        (unsigned long) (sizeof mask * CHAR_BIT),
+        NULL,
+        (unsigned long) DPoolMpolFMemsAllowed
+      ))
+      return 0;
+    count = 0;
+    for (i = 0; i < DPoolNodeMaskWords; ++i)
+      {
+        for (word = mask[i]; word; word &= word - 1)
+          ++count;
+      }
+    return count > 1;
+#else
+    return 0;
+#endif
+  }
+
+/*
+ * Used by pool_cache_refill.  Pops one batch from Node, or returns a null
+ * pointer if there is none.  A batch read as the first might be popped by
+ * another cache before the exchange, and even pushed again, but then the
+ * generation differs.  Its link can still be read meanwhile, as records
+ * are not released until the pool is destroyed
+ */
+static struct pool_batch * pool_pop_batch(struct pool_node * Node)
+  {
+    struct pool_batch * batch;
+    struct pool_depot desired;
+    struct pool_depot expected;
+
+    DPoolLoadDepot(&Node->depot, &expected);
+    do
+      {
+        batch = expected.batches;
+        if (!batch)
+          return NULL;
+        desired.batches = DPoolLoad(&batch->next_batch);
+        desired.generation = expected.generation + 1;
+      }
+      while (!DPoolCompareExchangeDepot(&Node->depot, &expected, &desired));
+    DPoolFetchSub(&Node->stats.depot_count, batch->count);
+    return batch;
+  }
+
+/* Used by pool_cache_spill.  Pushes Batch onto Node */
+static void pool_push_batch(
+    struct pool_node * Node,
+    struct pool_batch * Batch
+  )
+  {
+    struct pool_depot desired;
+    struct pool_depot expected;
+
+    desired.batches = Batch;
+    DPoolLoadDepot(&Node->depot, &expected);
+    do
+      {
+        /* Caches popping a stale first batch might be reading this link */
+        DPoolStore(&Batch->next_batch, (struct pool_batch *) expected.batches);
+        desired.generation = expected.generation + 1;
+      }
+      while (!DPoolCompareExchangeDepot(&Node->depot, &expected, &desired));
+  }
+
+/*
+ * Used by PoolAlloc and PoolReserve.  Pushes one new slab of at least Count
+ * records onto the free list, on the node chosen by PoolSetNode.  Returns
+ * the number of records obtained
+ */
+static size_t pool_refill(struct pool * Pool, size_t Count)
+  {
+    void * first;
+
+    first = pool_slab(
+        Pool,
+        &Count,
+        Pool->free_list,
+        Pool->node < 0 ? PoolCurrentNode() : Pool->node
+      );
+    if (!first)
+      return 0;
+    Pool->free_list = first;
+    Pool->stats.counts.free_count += Count;
+    return Count;
+  }
+
+/*
+ * Used by pool_cache_refill and pool_refill.  Obtains one slab of *Count
+ * records, plus a slot for linking it to the other slabs, and links the
+ * records through their first bytes, with the last linking to Next.  On a
+ * system with more than one node, the slab is mapped and placed on Node,
+ * if it is known, and then holds as many more records as fit in the last
+ * page, with the number stored into *Count.  Returns the first record, or
+ * a null pointer if the allocation failed
+ */
+static void * pool_slab(
+    struct pool * Pool,
+    size_t * Count,
+    void * Next,
+    int Node
+  )
+  {
+    void * expected;
+    size_t i;
+    struct pool_node * node;
+#ifdef DPoolNuma
+    size_t page;
+#endif
+    int placed;
+    char * record;
+    size_t size;
+    char * slab;
+
+    if (!*Count || *Count > SIZE_MAX / Pool->stride - 1)
+      return NULL;
+    size = (*Count + 1) * Pool->stride;
+
+    placed = 0;
+    slab = NULL;
+#ifdef DPoolNuma
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    if (Pool->numa && Node >= 0 && size <= (SIZE_MAX & ~(page - 1)))
+      {
+        size = (size + page - 1) & ~(page - 1);
+        slab = pool_map(size, Node, &placed);
+        if (slab)
+          *Count = size / Pool->stride - 1;
+      }
+#endif
+    if (!slab)
+      {
+        slab = malloc(size);
+        if (!slab)
+          return NULL;
+        size = 0;
+      }
+    ((struct pool_slab *) slab)->size = size;
+
+    /* Link the records from the end, so they are handed out in order */
+    for (i = *Count; i; --i)
+      {
+        record = slab + i * Pool->stride;
+        *(void **) record = Next;
+        Next = record;
+      }
+
+    expected = DPoolLoad(&Pool->slabs);
+    do
+      ((struct pool_slab *) slab)->next = expected;
+      while (!DPoolCompareExchange(&Pool->slabs, &expected, (void *) slab));
+    DPoolFetchAdd(&Pool->stats.counts.slab_count, 1);
+    node = pool_node(Pool, Node);
+    DPoolFetchAdd(&node->stats.slab_count, 1);
+    if (placed)
+      DPoolFetchAdd(&node->stats.placed_count, 1);
+    return Next;
+  }
+
+size_t PoolReserve(struct pool * Pool, size_t Count)
+  {
+    if (Count > Pool->stats.counts.free_count)
+      pool_refill(Pool, Count - Pool->stats.counts.free_count);
+    return Pool->stats.counts.free_count;
+  }
+
+void PoolSetNode(struct pool * Pool, int Node)
+  {
+    Pool->node = Node < 0 ? DPoolAnyNode : Node;
+  }
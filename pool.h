@@ -0,0 +1,317 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_pool
+#define DIncluded_pool 1
+#include <stddef.h>
+#include "align.h"
+/* Records obtained by each refill, if PoolInit is not told otherwise */
+#define DPoolRefillCount 64
+/*
+ * NUMA nodes with their own depots and counters.  Nodes beyond these share
+ * them, modulo this count, though their slabs are still placed on them.
+ * The size of struct pool depends on it, so it is not to be changed
+ */
+#define DPoolMaxNodes 8
+/* For PoolCacheInitNode and PoolSetNode: the node of the calling thread */
+#define DPoolAnyNode (-1)
+/*
+ * Aligns the parts of a pool written by caches to cache lines.  Only
+ * needed where caches may be used by many threads, which needs GCC or
+ * clang for the atomic operations of pool.c
+ */
+#ifdef __GNUC__
+#define DPoolAligned __attribute__((aligned(DAlignCacheLine)))
+#else
+#define DPoolAligned
+#endif
+
+/* Counters describing a pool, as filled by PoolGetStats */
+struct pool_stats
+  {
+    /* Records held by the pool in batches, for caches */
+    size_t depot_count;
+    /* Records on the free list */
+    size_t free_count;
+    /*
+     * The most records that have been allocated at once.  Records allocated
+     * and freed through a cache are counted here and in in_use whenever the
+     * cache draws a batch, returns one or is flushed
+     */
+    size_t high_water;
+    /* Records currently allocated */
+    size_t in_use;
+    /* Slabs obtained from the system allocator */
+    size_t slab_count;
+  };
+
+/* Counters describing one node of a pool, as filled by PoolGetNodeStats */
+struct pool_node_stats
+  {
+    /* Records held by the node's depot in batches, for its caches */
+    size_t depot_count;
+    /* Slabs obtained for the node */
+    size_t slab_count;
+    /* Of those, slabs which the operating system agreed to place there */
+    size_t placed_count;
+  };
+
+/*
+ * A stack of batches of free records.  Every change to it also changes the
+ * generation, so that a compare-and-exchange cannot mistake a batch which
+ * was popped and pushed again, meanwhile, for one which never left
+ */
+struct pool_depot
+  {
+    /* The first batch, or a null pointer */
+    void * batches;
+    size_t generation;
+  };
+
+/* The part of a pool for one NUMA node */
+struct pool_node
+  {
+    /* Batches of free records, for caches on the node */
+    struct pool_depot depot;
+    struct pool_node_stats stats;
+  };
+
+/* Bytes from the part of a pool for one node to the next */
+#define DPoolNodeSpan \
+  ((sizeof (struct pool_node) + DAlignCacheLine - 1) / DAlignCacheLine * \
+    DAlignCacheLine)
+
+/*
+ * The part of a pool for one node, on cache lines of its own, as caches on
+ * different nodes update different parts.  Some targets also need the
+ * alignment for exchanging both words of the depot at once
+ */
+union pool_node_line
+  {
+    struct pool_node node;
+    char padding[DPoolNodeSpan];
+  }
+  DPoolAligned;
+
+/*
+ * The counters of a pool, on cache lines of their own, as caches update
+ * them with atomic operations.  The depot count is unused, as each node
+ * counts its own
+ */
+union pool_stats_line
+  {
+    struct pool_stats counts;
+    char padding[(sizeof (struct pool_stats) + DAlignCacheLine - 1) /
+      DAlignCacheLine * DAlignCacheLine];
+  }
+  DPoolAligned;
+
+/*
+ * A pool of equally-sized head and tail records, carved from slabs.  Its
+ * members are private to pool.c.  A pool may be shared by many threads
+ * through caches, but the PoolAlloc, PoolFree and PoolReserve functions are
+ * only for a pool used by a single thread.  A pool is aligned to
+ * DAlignCacheLine, which storage for one from malloc might not be, so such
+ * storage should come from an aligned allocator, such as posix_memalign
+ */
+struct pool
+  {
+    /* Free records, each linked to the next through its first bytes */
+    void * free_list;
+    /* The layout of each record */
+    struct tail_layout layout;
+    /* The node for refills of the free list, or DPoolAnyNode */
+    int node;
+    /* Depots and counters, for each node */
+    union pool_node_line nodes[DPoolMaxNodes];
+    /* Non-zero if slabs are placed on nodes */
+    int numa;
+    /* Records obtained by each refill */
+    size_t refill_count;
+    /* Slabs, each linked to the next through its first record-sized slot */
+    void * slabs;
+    union pool_stats_line stats;
+    /* Distance between records in a slab */
+    size_t stride;
+  };
+
+/*
+ * A cache of free records for one thread, drawing batches of records from
+ * a shared pool and returning them there.  Records freed by any thread go
+ * to that thread's cache.  Its members are private to pool.c
+ */
+struct pool_cache
+  {
+    /* Free records, each linked to the next through its first bytes */
+    void * free_list;
+    /* Records on the free list */
+    size_t free_count;
+    /*
+     * Records allocated through the cache, less those freed through it,
+     * since it last added them to the counters of the pool.  This wraps
+     * around, when more have been freed
+     */
+    size_t in_use;
+    /* The node which the cache draws from, or DPoolAnyNode if unknown */
+    int node;
+    /* The shared pool */
+    struct pool * pool;
+    /* A full batch of records, or a null pointer */
+    void * spare;
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * Allocates a record from Pool and returns a pointer to its head.  If Tail
+ * is non-null, a pointer to the record's tail is stored there.  The system
+ * allocator is only called when the free list is empty, to refill it.  If
+ * that fails, this function returns a null pointer and stores a null
+ * pointer into Tail
+ */
+extern void * PoolAlloc(struct pool * Pool, void ** Tail);
+/*
+ * Allocates a record through Cache, just as PoolAlloc would.  The shared
+ * pool is only consulted when the cache is empty, to obtain a batch of
+ * records, and the system allocator only when the pool has no batches
+ */
+extern void * PoolCacheAlloc(struct pool_cache * Cache, void ** Tail);
+/*
+ * Returns all of the records in Cache to its shared pool.  A thread should
+ * call this before it stops using the cache
+ */
+extern void PoolCacheFlush(struct pool_cache * Cache);
+/*
+ * Returns a record to Cache, given its head, which may have been allocated
+ * through any cache of the same pool.  Head may be null.  Once the cache
+ * holds two batches of records, one batch is returned to the shared pool
+ */
+extern void PoolCacheFree(struct pool_cache * Cache, void * Head);
+/*
+ * Prepares Cache for use by one thread with Pool, which must have been
+ * initialized.  Each batch has the refill count given to PoolInit.  The
+ * cache draws from the node of the calling thread, as PoolCacheInitNode
+ * would with DPoolAnyNode, so a thread should initialize its own cache
+ */
+extern void PoolCacheInit(struct pool_cache * Cache, struct pool * Pool);
+/*
+ * As PoolCacheInit, but the cache draws batches from, and returns them to,
+ * the depot of Node, and new slabs for it are placed on Node, where the
+ * operating system supports that.  Records freed to the cache join it,
+ * wherever they were placed
+ */
+extern void PoolCacheInitNode(
+    struct pool_cache * Cache,
+    struct pool * Pool,
+    int Node
+  );
+/*
+ * Returns the NUMA node of the processor running the calling thread, or
+ * DPoolAnyNode if that cannot be known
+ */
+extern int PoolCurrentNode(void);
+/*
+ * Releases all of the slabs of Pool, including any records which have not
+ * been freed.  No cache may be using Pool.  Pool may be initialized again
+ * afterwards
+ */
+extern void PoolDestroy(struct pool * Pool);
+/* Returns a record to Pool, given its head.  Head may be null */
+extern void PoolFree(struct pool * Pool, void * Head);
+/* Copies the layout of each record of Pool, from TailLayout, into Layout */
+extern void PoolGetLayout(
+    const struct pool * Pool,
+    struct tail_layout * Layout
+  );
+/*
+ * Copies the counters of Node of Pool into Stats.  Nodes beyond
+ * DPoolMaxNodes share counters, as they share depots
+ */
+extern void PoolGetNodeStats(
+    const struct pool * Pool,
+    int Node,
+    struct pool_node_stats * Stats
+  );
+/* Copies the counters of Pool into Stats */
+extern void PoolGetStats(const struct pool * Pool, struct pool_stats * Stats);
+/*
+ * Prepares Pool for records of a head and a tail, sized by TailAlignedSize.
+ * Each refill obtains RefillCount records, or DPoolRefillCount records if
+ * RefillCount is zero.  Slabs for the free list are placed on the node of
+ * the thread refilling it, until PoolSetNode says otherwise.  Returns the
+ * size of each record, or zero if Pool is null or TailAlignedSize would
+ * return zero
+ */
+extern size_t PoolInit(
+    struct pool * Pool,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t RefillCount
+  );
+/*
+ * As PoolInit, but with the alignments of TailLayoutEx, for a head or a
+ * tail whose size is a multiple of more than its alignment.  Returns zero
+ * if TailLayoutEx would
+ */
+extern size_t PoolInitEx(
+    struct pool * Pool,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    size_t RefillCount
+  );
+/*
+ * Ensures that at least Count records are free, with at most one new slab.
+ * Returns the number of free records, which is less than Count if the
+ * system allocator failed
+ */
+extern size_t PoolReserve(struct pool * Pool, size_t Count);
+/*
+ * Places the slabs obtained from now on for the free list of Pool on Node,
+ * or on the node of the thread refilling it if Node is DPoolAnyNode
+ */
+extern void PoolSetNode(struct pool * Pool, int Node);
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_pool */
@@ -0,0 +1,265 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A stress test of the caches of pool.c.  Threads allocate and free records
+ * through their own caches, handing some of them to each other to be freed
+ * through other caches, and check that no record is handed out twice at
+ * once.  Build it with threads, and with ThreadSanitizer where available:
+ *
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -O1 -pthread \
+ *     -fsanitize=thread -o pool_test align.c pool.c pool_test.c -latomic
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "align.h"
+#include "pool.h"
+
+/* Threads sharing the pool */
+#define DTestThreads 4
+/* Rounds of allocations and frees by each thread */
+#define DTestRounds 2000
+/* The most records that each thread holds at once */
+#define DTestHeld 150
+/* Records waiting to be freed by another thread */
+#define DTestMailbox 64
+/* A head to keep the stamps clear of the links of free records */
+#define DTestHeadSize 32
+
+/* Written into the tail of each allocated record */
+struct stamp
+  {
+    unsigned long thread;
+    unsigned long serial;
+  };
+
+/* What each thread is doing */
+struct worker
+  {
+    pthread_t handle;
+    /* The node whose depot its cache uses, or DPoolAnyNode */
+    int node;
+    /* Non-zero if a check failed */
+    int failed;
+    unsigned long number;
+    /* Records stamped so far */
+    unsigned long serial;
+  };
+
+static int check_record(void * Head, unsigned long Thread);
+static void * run_worker(void * Argument);
+static void stamp_record(void * Head, struct worker * Worker);
+
+static size_t mailbox_count;
+static pthread_mutex_t mailbox_lock = PTHREAD_MUTEX_INITIALIZER;
+static void * mailbox[DTestMailbox];
+static unsigned long mailbox_owner[DTestMailbox];
+static struct pool pool;
+static struct tail_layout record_layout;
+
+int main(void)
+  {
+    struct pool_cache cache;
+    int failed;
+    size_t i;
+    struct pool_node_stats node_stats;
+    struct pool_stats stats;
+    size_t total;
+    struct worker workers[DTestThreads];
+
+    if (!PoolInit(&pool, DTestHeadSize, sizeof (struct stamp), 16))
+      {
+        fprintf(stderr, "pool_test: PoolInit failed\n");
+        return EXIT_FAILURE;
+      }
+    PoolGetLayout(&pool, &record_layout);
+
+    failed = 0;
+    for (i = 0; i < DTestThreads; ++i)
+      {
+        /* Half of the caches share the depot of the second node */
+        workers[i].node = i % 2 ? 1 : DPoolAnyNode;
+        workers[i].failed = 0;
+        workers[i].number = (unsigned long) i + 1;
+        workers[i].serial = 0;
+        if (pthread_create(&workers[i].handle, NULL, run_worker, workers + i))
+          {
+            fprintf(stderr, "pool_test: pthread_create failed\n");
+            return EXIT_FAILURE;
+          }
+      }
+    for (i = 0; i < DTestThreads; ++i)
+      {
+        pthread_join(workers[i].handle, NULL);
+        failed |= workers[i].failed;
+      }
+
+    /* Free whatever was left in the mailbox */
+    PoolCacheInit(&cache, &pool);
+    for (i = 0; i < mailbox_count; ++i)
+      {
+        failed |= check_record(mailbox[i], mailbox_owner[i]);
+        PoolCacheFree(&cache, mailbox[i]);
+      }
+    PoolCacheFlush(&cache);
+
+    PoolGetStats(&pool, &stats);
+    for ((total = 0), (i = 0); i < DPoolMaxNodes; ++i)
+      {
+        PoolGetNodeStats(&pool, (int) i, &node_stats);
+        total += node_stats.depot_count;
+      }
+    if (stats.depot_count != total)
+      {
+        fprintf(stderr, "pool_test: the depots do not add up\n");
+        failed = 1;
+      }
+    if (stats.in_use)
+      {
+        fprintf(stderr, "pool_test: records are still counted in use\n");
+        failed = 1;
+      }
+    /* Each thread holds its records, or has left them in the mailbox */
+    if (!stats.high_water ||
+      stats.high_water > DTestThreads * DTestHeld + DTestMailbox)
+      {
+        fprintf(stderr, "pool_test: the high-water mark is wrong\n");
+        failed = 1;
+      }
+
+    PoolDestroy(&pool);
+    if (failed)
+      return EXIT_FAILURE;
+    printf("pool_test: ok\n");
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * Used by main and run_worker.  Returns non-zero, after complaining, if
+ * the stamp of the record at Head is not one which Thread wrote
+ */
+static int check_record(void * Head, unsigned long Thread)
+  {
+    struct stamp * stamp;
+
+    stamp = TailFromHead(Head, &record_layout);
+    if (stamp->thread == Thread)
+      return 0;
+    fprintf(
+        stderr,
+        "pool_test: record %lu of thread %lu was handed out twice\n",
+        stamp->serial,
+        stamp->thread
+      );
+    return 1;
+  }
+
+/* Allocates and frees records through a cache of its own */
+static void * run_worker(void * Argument)
+  {
+    struct pool_cache cache;
+    size_t count;
+    void * held[DTestHeld];
+    size_t i;
+    size_t round;
+    struct worker * worker;
+
+    worker = Argument;
+    PoolCacheInitNode(&cache, &pool, worker->node);
+    for (round = 0; round < DTestRounds; ++round)
+      {
+        /* Vary the count, so that batches move in both directions */
+        count = 1 + (round * 37 + worker->number * 11) % DTestHeld;
+        for (i = 0; i < count; ++i)
+          {
+            held[i] = PoolCacheAlloc(&cache, NULL);
+            if (!held[i])
+              {
+                fprintf(stderr, "pool_test: PoolCacheAlloc failed\n");
+                worker->failed = 1;
+                count = i;
+                break;
+              }
+            stamp_record(held[i], worker);
+          }
+
+        /* Leave the last record for another thread, swapping it for one */
+        if (count)
+          {
+            pthread_mutex_lock(&mailbox_lock);
+            if (mailbox_count && mailbox_owner[0] != worker->number)
+              {
+                worker->failed |= check_record(mailbox[0], mailbox_owner[0]);
+                PoolCacheFree(&cache, mailbox[0]);
+                --mailbox_count;
+                mailbox[0] = mailbox[mailbox_count];
+                mailbox_owner[0] = mailbox_owner[mailbox_count];
+              }
+            if (mailbox_count < DTestMailbox)
+              {
+                --count;
+                mailbox[mailbox_count] = held[count];
+                mailbox_owner[mailbox_count] = worker->number;
+                ++mailbox_count;
+              }
+            pthread_mutex_unlock(&mailbox_lock);
+          }
+
+        /* Free the records in the opposite order */
+        for (i = count; i; --i)
+          {
+            worker->failed |= check_record(held[i - 1], worker->number);
+            PoolCacheFree(&cache, held[i - 1]);
+          }
+      }
+    PoolCacheFlush(&cache);
+    return NULL;
+  }
+
+/* Used by run_worker.  Stamps the tail of the record at Head for Worker */
+static void stamp_record(void * Head, struct worker * Worker)
+  {
+    struct stamp * stamp;
+
+    stamp = TailFromHead(Head, &record_layout);
+    stamp->thread = Worker->number;
+    stamp->serial = ++Worker->serial;
+  }
@@ -0,0 +1,571 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* Mapping storage needs the POSIX and Linux extensions of the C library */
+#ifdef __linux__
+#define _DEFAULT_SOURCE 1
+#endif
+/* C >= C99 required for SIZE_MAX */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DRegionMmap 1
+#endif
+#include "align.h"
+#include "region.h"
+
+static size_t region_check_header(
+    const struct region_file_header * Header,
+    size_t HeadSize,
+    size_t TailSize,
+    struct tail_layout * Layout
+  );
+static size_t region_data_offset(size_t Alignment, size_t StrideAlign);
+#ifdef DRegionMmap
+static char * region_map(
+    struct region * Region,
+    size_t Length,
+    size_t Align,
+    int Flags
+  );
+static char * region_map_file(
+    struct region * Region,
+    int File,
+    size_t Length,
+    size_t Align,
+    int Flags
+  );
+#endif
+
+void * RegionAlloc(
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t RoundTo,
+    void ** Tail
+  )
+  {
+    int flags;
+    void * head;
+
+    if (!RoundTo)
+      RoundTo = DAlignPageSize;
+    flags = DRegionMap;
+    if (RoundTo >= DAlignHugePageSize)
+      flags |= DRegionHugePages;
+
+    head = NULL;
+    if (RegionInit(Region, HeadSize, TailSize, 1, RoundTo, flags))
+      head = Region->base;
+    if (Tail)
+      *Tail = head ? RegionTail(Region, 0) : NULL;
+    return head;
+  }
+
+/*
+ * Used by RegionLoad.  Returns the stride described by Header, having
+ * filled Layout as RegionInit would for records of HeadSize and TailSize,
+ * or returns zero if Header was not written by RegionSave for such records
+ * on a platform like this one
+ */
+static size_t region_check_header(
+    const struct region_file_header * Header,
+    size_t HeadSize,
+    size_t TailSize,
+    struct tail_layout * Layout
+  )
+  {
+    size_t stride;
+
+    if (memcmp(Header->magic, DRegionFileMagic, sizeof Header->magic) ||
+      Header->version != DRegionFileVersion ||
+      Header->byte_order != DRegionFileByteOrder ||
+      Header->head_size != HeadSize ||
+      Header->tail_size != TailSize ||
+      Header->stride_align > SIZE_MAX ||
+      !Header->count ||
+      Header->count > SIZE_MAX)
+      return 0;
+
+    /* The layout must be the same as it was for the writer */
+    stride = TailLayoutRounded(
+        Layout,
+        HeadSize,
+        0,
+        TailSize,
+        0,
+        (size_t) Header->stride_align
+      );
+    if (!stride ||
+      Header->stride != stride ||
+      Header->tail_offset != Layout->tail_offset ||
+      Header->alignment != Layout->alignment ||
+      Header->count > SIZE_MAX / stride ||
+      Header->data_offset != region_data_offset(
+          Layout->alignment,
+          (size_t) Header->stride_align
+        ) ||
+      Header->data_offset > SIZE_MAX - Header->count * stride)
+      return 0;
+    return stride;
+  }
+
+/*
+ * Used by RegionLoad and RegionSave.  Returns the offset of the first
+ * record into a file: after the header, at a multiple of DAlignPageSize,
+ * of Alignment and of StrideAlign, which are powers of two or zero
+ */
+static size_t region_data_offset(size_t Alignment, size_t StrideAlign)
+  {
+    size_t align;
+
+    align = DAlignPageSize;
+    if (Alignment > align)
+      align = Alignment;
+    if (StrideAlign > align)
+      align = StrideAlign;
+    return (sizeof (struct region_file_header) + align - 1) & ~(align - 1);
+  }
+
+void RegionDestroy(struct region * Region)
+  {
+#ifdef DRegionMmap
+    if (Region->flags & DRegionMap)
+      munmap(Region->storage, Region->size);
+      else
+#endif
+      free(Region->storage);
+    Region->base = NULL;
+    Region->count = 0;
+    Region->flags = 0;
+    Region->size = 0;
+    Region->storage = NULL;
+  }
+
+void RegionGetLayout(
+    const struct region * Region,
+    struct tail_layout * Layout
+  )
+  {
+    *Layout = Region->layout;
+  }
+
+void * RegionHead(const struct region * Region, size_t Index)
+  {
+    if (Index >= Region->count)
+      return NULL;
+    return Region->base + Index * Region->stride;
+  }
+
+size_t RegionIndex(const struct region * Region, const void * Head)
+  {
+    size_t offset;
+
+    if (!Region->count ||
+      (const char *) Head < Region->base ||
+      (const char *) Head >= Region->base + Region->count * Region->stride)
+      return Region->count;
+    offset = (size_t) ((const char *) Head - Region->base);
+    if (offset % Region->stride)
+      return Region->count;
+    return offset / Region->stride;
+  }
+
+size_t RegionInit(
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Count,
+    size_t StrideAlign,
+    int Flags
+  )
+  {
+    char * base;
+    size_t extra;
+    size_t size;
+    size_t skew;
+    char * storage;
+    size_t stride;
+
+    if (!Region)
+      return 0;
+    stride = TailLayoutRounded(
+        &Region->layout,
+        HeadSize,
+        0,
+        TailSize,
+        0,
+        StrideAlign
+      );
+    if (!Count || !stride || Count > SIZE_MAX / stride)
+      return 0;
+    size = Count * stride;
+
+    base = NULL;
+#ifdef DRegionMmap
+    if (Flags & (DRegionMap | DRegionHugePages))
+      base = region_map(Region, size, StrideAlign, Flags);
+#else
+    (void) Flags;
+#endif
+    if (!base)
+      {
+        /* The system allocator might not align to StrideAlign */
+        extra = StrideAlign ? StrideAlign - 1 : 0;
+        if (size > SIZE_MAX - extra)
+          return 0;
+        storage = malloc(size + extra);
+        if (!storage)
+          return 0;
+        skew = extra ? (size_t) storage & extra : 0;
+        base = skew ? storage + (StrideAlign - skew) : storage;
+        Region->flags = 0;
+        Region->size = size + extra;
+        Region->storage = storage;
+      }
+
+    Region->base = base;
+    Region->count = Count;
+    Region->stride = stride;
+    Region->stride_align = StrideAlign;
+    return stride;
+  }
+
+size_t RegionLoad(
+    struct region * Region,
+    const char * Path,
+    size_t HeadSize,
+    size_t TailSize,
+    int Flags
+  )
+  {
+    char * base;
+    size_t count;
+    size_t data_offset;
+    FILE * file;
+    struct region_file_header header;
+    struct tail_layout layout;
+    size_t stride;
+
+    if (!Region || !Path)
+      return 0;
+    file = fopen(Path, Flags & DRegionShared ? "r+b" : "rb");
+    if (!file)
+      return 0;
+    stride = 0;
+    if (fread(&header, sizeof header, 1, file) == 1)
+      stride = region_check_header(&header, HeadSize, TailSize, &layout);
+    if (!stride)
+      {
+        fclose(file);
+        return 0;
+      }
+    count = (size_t) header.count;
+    data_offset = (size_t) header.data_offset;
+
+    base = NULL;
+#ifdef DRegionMmap
+    base = region_map_file(
+        Region,
+        fileno(file),
+        data_offset + count * stride,
+        data_offset,
+        Flags
+      );
+    if (base)
+      {
+        Region->base = base + data_offset;
+        Region->count = count;
+        Region->layout = layout;
+        Region->stride = stride;
+        Region->stride_align = (size_t) header.stride_align;
+      }
+#endif
+
+    /* Read the records, unless they had to be shared with the file */
+    if (!base)
+      {
+        if (Flags & DRegionShared ||
+          data_offset > (size_t) LONG_MAX ||
+          !RegionInit(
+              Region,
+              HeadSize,
+              TailSize,
+              count,
+              (size_t) header.stride_align,
+              0
+            ))
+          stride = 0;
+        if (stride &&
+          (fseek(file, (long) data_offset, SEEK_SET) ||
+            fread(Region->base, stride, count, file) != count))
+          {
+            RegionDestroy(Region);
+            stride = 0;
+          }
+      }
+
+    fclose(file);
+    return stride;
+  }
+
+#ifdef DRegionMmap
+/*
+ * Used by RegionInit.  Maps storage for at least Length bytes, beginning at
+ * a multiple of Align, if non-zero, and of the page size, or of the huge
+ * page size for DRegionHugePages.  Huge pages are mapped directly if the
+ * system has some reserved, or else asked for with madvise.  Fills in the
+ * storage, size and flags of Region and returns the storage, or returns a
+ * null pointer if mapping failed or Length is too large
+ */
+static char * region_map(
+    struct region * Region,
+    size_t Length,
+    size_t Align,
+    int Flags
+  )
+  {
+    char * base;
+    char * end;
+    size_t page;
+    size_t size;
+    size_t skew;
+    char * storage;
+
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    if (Flags & DRegionHugePages && Align < DRegionHugePageSize)
+      Align = DRegionHugePageSize;
+    if (Align < page)
+      Align = page;
+    if (Length > (SIZE_MAX & ~(Align - 1)))
+      return NULL;
+    Length = (Length + Align - 1) & ~(Align - 1);
+
+#ifdef MAP_HUGETLB
+    if (Flags & DRegionHugePages && Align == DRegionHugePageSize)
+      {
+        storage = mmap(
+            NULL,
+            Length,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0
+          );
+        if (storage != MAP_FAILED)
+          {
+            Region->flags = DRegionMap | DRegionHugePages;
+            Region->size = Length;
+            Region->storage = storage;
+            return storage;
+          }
+      }
+#endif
+
+    /* Map more than enough, then unmap what lies outside of the alignment */
+    size = Length;
+    if (Align > page)
+      {
+        if (size > SIZE_MAX - Align)
+          return NULL;
+        size += Align;
+      }
+    storage = mmap(
+        NULL,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0
+      );
+    if (storage == MAP_FAILED)
+      return NULL;
+    skew = (size_t) storage & (Align - 1);
+    base = skew ? storage + (Align - skew) : storage;
+    end = base + Length;
+    if (base != storage)
+      munmap(storage, (size_t) (base - storage));
+    if (end != storage + size)
+      munmap(end, (size_t) (storage + size - end));
+
+    Region->flags = DRegionMap;
+#ifdef MADV_HUGEPAGE
+    if (Flags & DRegionHugePages && !madvise(base, Length, MADV_HUGEPAGE))
+      Region->flags |= DRegionHugePages;
+#endif
+    Region->size = Length;
+    Region->storage = base;
+    return base;
+  }
+
+/*
+ * Used by RegionLoad.  Maps the first Length bytes of the file open as
+ * File, beginning at a multiple of Align and of the page size, shared with
+ * the file for DRegionShared or else private.  Fills in the storage, size
+ * and flags of Region and returns the storage, or returns a null pointer
+ * if the file is shorter than Length or mapping failed
+ */
+static char * region_map_file(
+    struct region * Region,
+    int File,
+    size_t Length,
+    size_t Align,
+    int Flags
+  )
+  {
+    char * base;
+    char * end;
+    struct stat info;
+    char * mapped;
+    size_t page;
+    size_t size;
+    size_t skew;
+    char * storage;
+
+    if (fstat(File, &info) || info.st_size < 0 ||
+      (uintmax_t) info.st_size < Length)
+      return NULL;
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    if (Align < page)
+      Align = page;
+
+    /* Reserve more than enough, then map the file at the alignment */
+    size = Length;
+    if (Align > page)
+      {
+        if (size > SIZE_MAX - Align)
+          return NULL;
+        size += Align;
+      }
+    storage = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (storage == MAP_FAILED)
+      return NULL;
+    skew = (size_t) storage & (Align - 1);
+    base = skew ? storage + (Align - skew) : storage;
+    mapped = mmap(
+        base,
+        Length,
+        PROT_READ | PROT_WRITE,
+        (Flags & DRegionShared ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED,
+        File,
+        0
+      );
+    if (mapped == MAP_FAILED)
+      {
+        munmap(storage, size);
+        return NULL;
+      }
+    end = base + ((Length + page - 1) & ~(page - 1));
+    if (base != storage)
+      munmap(storage, (size_t) (base - storage));
+    if (end < storage + size)
+      munmap(end, (size_t) (storage + size - end));
+
+    Region->flags = DRegionMap | (Flags & DRegionShared);
+    Region->size = Length;
+    Region->storage = base;
+    return base;
+  }
+#endif
+
+size_t RegionSave(const struct region * Region, const char * Path)
+  {
+    size_t data_offset;
+    int failed;
+    FILE * file;
+    struct region_file_header header;
+    size_t i;
+    size_t length;
+    size_t size;
+    static const char zeros[256];
+
+    if (!Region || !Region->count || !Path)
+      return 0;
+    data_offset = region_data_offset(
+        Region->layout.alignment,
+        Region->stride_align
+      );
+    size = Region->count * Region->stride;
+    if (data_offset > SIZE_MAX - size)
+      return 0;
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, DRegionFileMagic, sizeof header.magic);
+    header.version = DRegionFileVersion;
+    header.byte_order = DRegionFileByteOrder;
+    header.count = Region->count;
+    header.head_size = Region->layout.tail_offset - Region->layout.padding;
+    header.tail_size =
+      Region->layout.total_size - Region->layout.tail_offset;
+    header.alignment = Region->layout.alignment;
+    header.stride_align = Region->stride_align;
+    header.tail_offset = Region->layout.tail_offset;
+    header.stride = Region->stride;
+    header.data_offset = data_offset;
+
+    file = fopen(Path, "wb");
+    if (!file)
+      return 0;
+    failed = fwrite(&header, sizeof header, 1, file) != 1;
+    for (i = sizeof header; !failed && i < data_offset; i += length)
+      {
+        length = data_offset - i;
+        if (length > sizeof zeros)
+          length = sizeof zeros;
+        failed = fwrite(zeros, 1, length, file) != length;
+      }
+    if (!failed)
+      failed = fwrite(Region->base, 1, size, file) != size;
+    if (fclose(file))
+      failed = 1;
+    return failed ? 0 : data_offset + size;
+  }
+
+void * RegionTail(const struct region * Region, size_t Index)
+  {
+    if (Index >= Region->count)
+      return NULL;
+    return Region->base + Index * Region->stride + Region->layout.tail_offset;
+  }
@@ -0,0 +1,224 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_region
+#define DIncluded_region 1
+#include <stddef.h>
+/* C >= C99 required for uint32_t and uint64_t */
+#include <stdint.h>
+#include "align.h"
+/* Flags for RegionInit and RegionLoad */
+#define DRegionMap 1
+#define DRegionHugePages 2
+#define DRegionShared 4
+/* The size of the huge pages asked for by DRegionHugePages */
+#define DRegionHugePageSize DAlignHugePageSize
+/* The first bytes of a file written by RegionSave, with a null character */
+#define DRegionFileMagic "ALNREGN"
+/* Incremented whenever struct region_file_header changes */
+#define DRegionFileVersion 1
+/* The byte_order written by RegionSave, read differently elsewhere */
+#define DRegionFileByteOrder ((uint32_t) 0x01020304)
+
+/*
+ * A fixed number of equally-sized head and tail records, contiguous in one
+ * block of storage, obtained all at once.  Its members are private to
+ * region.c
+ */
+struct region
+  {
+    /* The first record */
+    char * base;
+    /* Records in the region */
+    size_t count;
+    /* DRegionMap and DRegionHugePages, for how the storage was obtained */
+    int flags;
+    /* The layout of each record */
+    struct tail_layout layout;
+    /* Bytes obtained for the storage */
+    size_t size;
+    /* The storage, as obtained */
+    void * storage;
+    /* Distance between records */
+    size_t stride;
+    /* StrideAlign, as given to RegionInit */
+    size_t stride_align;
+  };
+
+/*
+ * The beginning of a file written by RegionSave.  The records follow at
+ * data_offset, exactly as they were in the region, so a region loaded from
+ * the file has the same layout.  Every member has the same size on every
+ * platform, but the byte order is that of the writer
+ */
+struct region_file_header
+  {
+    /* DRegionFileMagic */
+    char magic[8];
+    /* DRegionFileVersion */
+    uint32_t version;
+    /* DRegionFileByteOrder */
+    uint32_t byte_order;
+    /* Records in the region */
+    uint64_t count;
+    /* The sizes given to RegionInit */
+    uint64_t head_size;
+    uint64_t tail_size;
+    /* The strictest alignment inferred for the head and the tail */
+    uint64_t alignment;
+    /* StrideAlign, as given to RegionInit */
+    uint64_t stride_align;
+    /* Offset of each tail into its record */
+    uint64_t tail_offset;
+    /* Distance between records */
+    uint64_t stride;
+    /* Offset of the first record into the file */
+    uint64_t data_offset;
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * Maps storage for a single large record of a head and a tail, as
+ * RegionInit would for a count of one with DRegionMap, and returns a
+ * pointer to its head.  The record is laid out by TailLayoutRounded with
+ * RoundTo, or with DAlignPageSize if RoundTo is zero, so the tail is at the
+ * end of the last page.  If RoundTo is at least DAlignHugePageSize, huge
+ * pages are asked for too.  If Tail is non-null, a pointer to the tail is
+ * stored there.  If RegionInit would return zero, this function returns a
+ * null pointer and stores a null pointer into Tail.  The storage is
+ * released with RegionDestroy
+ */
+extern void * RegionAlloc(
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t RoundTo,
+    void ** Tail
+  );
+/*
+ * Releases the storage of Region.  Region may be initialized again
+ * afterwards, or destroyed again, which does nothing
+ */
+extern void RegionDestroy(struct region * Region);
+/*
+ * Copies the layout of each record of Region, from TailLayoutRounded, into
+ * Layout
+ */
+extern void RegionGetLayout(
+    const struct region * Region,
+    struct tail_layout * Layout
+  );
+/*
+ * Returns a pointer to the head of record Index of Region, or a null
+ * pointer if Index is not less than the count given to RegionInit
+ */
+extern void * RegionHead(const struct region * Region, size_t Index);
+/*
+ * Returns the index of the record of Region whose head is at Head, or the
+ * count given to RegionInit if Head is not the head of such a record
+ */
+extern size_t RegionIndex(const struct region * Region, const void * Head);
+/*
+ * Obtains storage for Count records of a head and a tail, sized by
+ * TailAlignedSize and placed TailAlignedStride apart, with StrideAlign.
+ * Each record is laid out by TailLayoutRounded, with StrideAlign as
+ * RoundTo, so each tail is at the end of its stride.
+ * The storage is obtained from the system allocator, unless Flags include:
+ *   DRegionMap: The storage is mapped from the operating system, where it
+ *     supports that, and so it is zero-filled
+ *   DRegionHugePages: As for DRegionMap, but asking for huge pages of
+ *     DRegionHugePageSize, which reduce TLB misses for a large region
+ * Either falls back to the system allocator if mapping fails.  The flags
+ * member of Region tells which were honoured.
+ *   Returns the stride, or zero if Region is null, Count is zero,
+ * TailAlignedStride would return zero, the storage would be too large, or
+ * it could not be obtained
+ */
+extern size_t RegionInit(
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Count,
+    size_t StrideAlign,
+    int Flags
+  );
+/*
+ * Initializes Region with the records in the file at Path, written by
+ * RegionSave for the same HeadSize and TailSize.  Where the operating
+ * system supports it, the file is mapped, so loading takes no copying,
+ * and RegionHead, RegionTail and HeadFromTail work on the mapping at once.
+ * The records must hold no pointers, which would not survive this, but
+ * only offsets such as those of RegionIndex.  Changes to the records are
+ * private to the process, unless Flags include DRegionShared, in which
+ * case they are written back to the file, which must then be writable.
+ * Elsewhere, or if mapping fails, and without DRegionShared, the records
+ * are read into storage from RegionInit instead.  The flags member of
+ * Region tells which was done.  The storage is released with
+ * RegionDestroy.
+ *   Returns the stride, or zero if Region is null, the file could not be
+ * read, or its header does not describe the layout of such records here
+ */
+extern size_t RegionLoad(
+    struct region * Region,
+    const char * Path,
+    size_t HeadSize,
+    size_t TailSize,
+    int Flags
+  );
+/*
+ * Writes the records of Region to a file at Path, replacing any file
+ * there, with a struct region_file_header describing them, for
+ * RegionLoad.  The records are aligned within the file as strictly as in
+ * the region, and to DAlignPageSize.  Returns the size of the file, or
+ * zero if it could not be written, in which case it might be incomplete
+ */
+extern size_t RegionSave(const struct region * Region, const char * Path);
+/*
+ * Returns a pointer to the tail of record Index of Region, or a null
+ * pointer if Index is not less than the count given to RegionInit
+ */
+extern void * RegionTail(const struct region * Region, size_t Index);
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_region */
@@ -0,0 +1,484 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A test of the files of region.c.  A region is saved, loaded back and
+ * compared, loaded again after each member of the file's header has been
+ * changed, which must fail, and destroyed twice.  Regions of other sizes
+ * and stride alignments, allocated and mapped, are checked for where their
+ * records are, as are large records from RegionAlloc.  Where regions are
+ * mapped from files, that is what a load does; elsewhere, the records are
+ * read.
+ * To test reading on such a system too, build it again without mapping:
+ *
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -o region_test align.c \
+ *     region.c region_test.c
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -U__linux__ \
+ *     -o region_test_read align.c region.c region_test.c
+ *
+ * The file is written at the path given as the only argument, or else at
+ * DTestPath in the current directory, and removed afterwards
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "align.h"
+#include "region.h"
+
+/* Records in the region */
+#define DTestCount 100
+/* Sizes of their heads and tails */
+#define DTestHeadSize 12
+#define DTestTailSize 20
+/* Not the default, so that a changed stride_align cannot describe it */
+#define DTestStrideAlign 64
+#define DTestPath "region_test.tmp"
+
+/* Sizes, a stride alignment and flags for RegionInit, for check_strides */
+struct test_stride
+  {
+    size_t head_size;
+    size_t tail_size;
+    size_t stride_align;
+    int flags;
+  };
+
+/* A member of the header of the file */
+struct test_field
+  {
+    const char * name;
+    size_t offset;
+  };
+
+static int check_alloc(int Mapped);
+static int check_records(const struct region * Region, int Changed);
+static int check_strides(void);
+static int destroy_twice(struct region * Region);
+static void fill_records(struct region * Region);
+static int flip_byte(const char * Path, size_t Offset);
+static unsigned char record_byte(size_t Index, size_t Offset);
+
+int main(int argc, char ** argv)
+  {
+    static const struct test_field fields[] =
+      {
+        { "magic", offsetof(struct region_file_header, magic) },
+        { "version", offsetof(struct region_file_header, version) },
+        { "byte_order", offsetof(struct region_file_header, byte_order) },
+        { "count", offsetof(struct region_file_header, count) },
+        { "head_size", offsetof(struct region_file_header, head_size) },
+        { "tail_size", offsetof(struct region_file_header, tail_size) },
+        { "alignment", offsetof(struct region_file_header, alignment) },
+        { "stride_align", offsetof(struct region_file_header, stride_align) },
+        { "tail_offset", offsetof(struct region_file_header, tail_offset) },
+        { "stride", offsetof(struct region_file_header, stride) },
+        { "data_offset", offsetof(struct region_file_header, data_offset) }
+      };
+    int failed;
+    size_t i;
+    struct region loaded;
+    int mapped;
+    const char * path;
+    struct region region;
+    size_t stride;
+
+    path = argc > 1 ? argv[1] : DTestPath;
+    stride = RegionInit(
+        &region,
+        DTestHeadSize,
+        DTestTailSize,
+        DTestCount,
+        DTestStrideAlign,
+        0
+      );
+    if (!stride)
+      {
+        fprintf(stderr, "region_test: RegionInit failed\n");
+        return EXIT_FAILURE;
+      }
+    fill_records(&region);
+    if (!RegionSave(&region, path))
+      {
+        fprintf(stderr, "region_test: RegionSave failed\n");
+        RegionDestroy(&region);
+        return EXIT_FAILURE;
+      }
+    failed = destroy_twice(&region);
+
+    if (RegionLoad(&loaded, path, DTestHeadSize, DTestTailSize, 0) != stride)
+      {
+        fprintf(stderr, "region_test: RegionLoad failed\n");
+        remove(path);
+        return EXIT_FAILURE;
+      }
+    mapped = loaded.flags & DRegionMap;
+    failed |= check_records(&loaded, 0);
+    for (i = 0; i < DTestCount; ++i)
+      {
+        if (RegionIndex(&loaded, RegionHead(&loaded, i)) != i ||
+          HeadFromTail(RegionTail(&loaded, i), &loaded.layout) !=
+          RegionHead(&loaded, i))
+          {
+            fprintf(
+                stderr,
+                "region_test: record %u is lost\n",
+                (unsigned int) i
+              );
+            failed = 1;
+            break;
+          }
+      }
+    failed |= destroy_twice(&loaded);
+
+    /* Sharing changes with the file is only possible where it is mapped */
+    stride = RegionLoad(
+        &loaded,
+        path,
+        DTestHeadSize,
+        DTestTailSize,
+        DRegionShared
+      );
+    if (!mapped != !stride)
+      {
+        fprintf(stderr, "region_test: DRegionShared was mishandled\n");
+        failed = 1;
+      }
+    if (stride)
+      {
+        *(unsigned char *) RegionHead(&loaded, 0) ^= 0xFF;
+        failed |= destroy_twice(&loaded);
+        if (RegionLoad(&loaded, path, DTestHeadSize, DTestTailSize, 0))
+          {
+            failed |= check_records(&loaded, 1);
+            RegionDestroy(&loaded);
+          }
+          else
+          {
+            failed = 1;
+          }
+      }
+
+    /* A file for other records must be refused */
+    if (RegionLoad(&loaded, path, DTestHeadSize + 4, DTestTailSize, 0) ||
+      RegionLoad(&loaded, path, DTestHeadSize, DTestTailSize - 4, 0))
+      {
+        fprintf(stderr, "region_test: a file for other sizes was loaded\n");
+        failed = 1;
+      }
+    for (i = 0; i < sizeof fields / sizeof *fields; ++i)
+      {
+        if (!flip_byte(path, fields[i].offset))
+          {
+            fprintf(stderr, "region_test: could not change the file\n");
+            failed = 1;
+            break;
+          }
+        if (RegionLoad(&loaded, path, DTestHeadSize, DTestTailSize, 0))
+          {
+            fprintf(
+                stderr,
+                "region_test: a file with a changed %s was loaded\n",
+                fields[i].name
+              );
+            RegionDestroy(&loaded);
+            failed = 1;
+          }
+        flip_byte(path, fields[i].offset);
+      }
+
+    remove(path);
+    failed |= check_strides();
+    failed |= check_alloc(mapped);
+    if (failed)
+      return EXIT_FAILURE;
+    printf(
+        "region_test: ok, with the records %s\n",
+        mapped ? "mapped" : "read"
+      );
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * Returns non-zero, after complaining, if RegionAlloc does not map a large
+ * record rounded up to pages, or to huge pages, with the head at the start
+ * of the storage and the tail at its end, as RegionGetLayout describes, or
+ * if it accepts a bad rounding.  If Mapped is non-zero, files could be
+ * mapped, so the records must be mapped too, and so zero-filled
+ */
+static int check_alloc(int Mapped)
+  {
+    static const size_t rounds[] = { 0, DAlignPageSize, DAlignHugePageSize };
+    unsigned char * head;
+    size_t i;
+    struct tail_layout layout;
+    size_t offset;
+    struct region region;
+    size_t round_to;
+    void * tail;
+
+    for (i = 0; i < sizeof rounds / sizeof *rounds; ++i)
+      {
+        round_to = rounds[i] ? rounds[i] : DAlignPageSize;
+        head = RegionAlloc(&region, 10000, 24, rounds[i], &tail);
+        if (!head)
+          {
+            fprintf(stderr, "region_test: RegionAlloc failed\n");
+            return 1;
+          }
+        RegionGetLayout(&region, &layout);
+        offset = 0;
+        while (Mapped && offset < layout.total_size && !head[offset])
+          ++offset;
+        if ((size_t) head % round_to ||
+          layout.total_size % round_to ||
+          (unsigned char *) tail != head + layout.tail_offset ||
+          layout.tail_offset + 24 != layout.total_size ||
+          layout.tail_offset < 10000 ||
+          (Mapped && (!(region.flags & DRegionMap) ||
+            offset < layout.total_size)))
+          {
+            fprintf(
+                stderr,
+                "region_test: a record rounded to %u is misplaced\n",
+                (unsigned int) round_to
+              );
+            RegionDestroy(&region);
+            return 1;
+          }
+        memset(head, 1, layout.total_size);
+        RegionDestroy(&region);
+      }
+
+    tail = &region;
+    if (RegionAlloc(&region, 10000, 24, 3000, &tail) || tail)
+      {
+        fprintf(stderr, "region_test: a bad rounding was allocated\n");
+        return 1;
+      }
+    return 0;
+  }
+
+/*
+ * Returns non-zero, after complaining, if the records of Region are not as
+ * fill_records left them, or if Changed is non-zero, as the test of
+ * DRegionShared left them
+ */
+static int check_records(const struct region * Region, int Changed)
+  {
+    size_t i;
+    const unsigned char * record;
+    size_t offset;
+    const struct tail_layout * layout;
+    unsigned char expected;
+
+    layout = &Region->layout;
+    for (i = 0; i < DTestCount; ++i)
+      {
+        record = RegionHead(Region, i);
+        for (offset = 0; offset < layout->total_size; ++offset)
+          {
+            expected = record_byte(i, offset);
+            if (Changed && !i && !offset)
+              expected ^= 0xFF;
+            if (record[offset] != expected)
+              {
+                fprintf(
+                    stderr,
+                    "region_test: byte %u of record %u differs\n",
+                    (unsigned int) offset,
+                    (unsigned int) i
+                  );
+                return 1;
+              }
+          }
+      }
+    return 0;
+  }
+
+/*
+ * Returns non-zero, after complaining, if RegionInit does not place the
+ * records of regions of various sizes and stride alignments, allocated or
+ * mapped, TailAlignedStride apart, each aligned to the stride alignment and
+ * with its tail at the end of its stride, or if it accepts a bad stride
+ * alignment or count.  Every byte of every record is written, so that a
+ * sanitizer would see any overrun
+ */
+static int check_strides(void)
+  {
+    static const struct test_stride strides[] =
+      {
+        { DTestHeadSize, DTestTailSize, 0, 0 },
+        { 3, 5, 16, 0 },
+        { 64, 64, 0, 0 },
+        { 100, 24, DAlignPageSize, 0 },
+        { DTestHeadSize, DTestTailSize, DTestStrideAlign, DRegionMap },
+        { 4000, 200, DAlignPageSize, DRegionMap },
+        { 1, 8, 0, DRegionHugePages }
+      };
+    char * head;
+    size_t i;
+    size_t j;
+    struct region region;
+    size_t stride;
+    const struct test_stride * test;
+
+    for (i = 0; i < sizeof strides / sizeof *strides; ++i)
+      {
+        test = strides + i;
+        stride = RegionInit(
+            &region,
+            test->head_size,
+            test->tail_size,
+            DTestCount,
+            test->stride_align,
+            test->flags
+          );
+        if (!stride || stride != TailAlignedStride(
+            test->head_size,
+            test->tail_size,
+            test->stride_align
+          ))
+          {
+            fprintf(
+                stderr,
+                "region_test: region %u has the wrong stride\n",
+                (unsigned int) i
+              );
+            if (stride)
+              RegionDestroy(&region);
+            return 1;
+          }
+
+        for (j = 0; j < DTestCount; ++j)
+          {
+            head = RegionHead(&region, j);
+            if (head != (char *) RegionHead(&region, 0) + j * stride ||
+              (test->stride_align &&
+                (size_t) head % test->stride_align) ||
+              (char *) RegionTail(&region, j) + test->tail_size !=
+              head + stride ||
+              RegionIndex(&region, head) != j ||
+              RegionIndex(&region, head + 1) != DTestCount)
+              break;
+            memset(head, (int) j, stride);
+          }
+        if (j < DTestCount || RegionHead(&region, DTestCount))
+          {
+            fprintf(
+                stderr,
+                "region_test: record %u of region %u is misplaced\n",
+                (unsigned int) j,
+                (unsigned int) i
+              );
+            RegionDestroy(&region);
+            return 1;
+          }
+        RegionDestroy(&region);
+      }
+
+    if (RegionInit(&region, DTestHeadSize, DTestTailSize, 1, 48, 0) ||
+      RegionInit(&region, DTestHeadSize, DTestTailSize, 0, 0, 0) ||
+      RegionInit(&region, DTestHeadSize, DTestTailSize, (size_t) -1, 0, 0))
+      {
+        fprintf(stderr, "region_test: a bad region was initialized\n");
+        RegionDestroy(&region);
+        return 1;
+      }
+    return 0;
+  }
+
+/*
+ * Destroys Region twice, which must be safe, and returns non-zero, after
+ * complaining, if it was not left empty
+ */
+static int destroy_twice(struct region * Region)
+  {
+    RegionDestroy(Region);
+    RegionDestroy(Region);
+    if (!Region->base && !Region->count && !Region->flags && !Region->size &&
+      !Region->storage)
+      return 0;
+    fprintf(stderr, "region_test: RegionDestroy left storage behind\n");
+    return 1;
+  }
+
+/* Fills every byte of every record of Region, head, padding and tail */
+static void fill_records(struct region * Region)
+  {
+    size_t i;
+    unsigned char * record;
+    size_t offset;
+
+    for (i = 0; i < DTestCount; ++i)
+      {
+        record = RegionHead(Region, i);
+        for (offset = 0; offset < Region->layout.total_size; ++offset)
+          record[offset] = record_byte(i, offset);
+      }
+  }
+
+/*
+ * Inverts the lowest bit of the byte at Offset into the file at Path, so
+ * that calling this again restores it.  Returns zero if that failed
+ */
+static int flip_byte(const char * Path, size_t Offset)
+  {
+    int byte;
+    int failed;
+    FILE * file;
+
+    file = fopen(Path, "r+b");
+    if (!file)
+      return 0;
+    byte = EOF;
+    failed = fseek(file, (long) Offset, SEEK_SET) ||
+      (byte = getc(file)) == EOF ||
+      fseek(file, (long) Offset, SEEK_SET) ||
+      putc(byte ^ 1, file) == EOF;
+    if (fclose(file))
+      failed = 1;
+    return !failed;
+  }
+
+/* Returns what fill_records writes at Offset into record Index */
+static unsigned char record_byte(size_t Index, size_t Offset)
+  {
+    return (unsigned char) (Index * 31 + Offset * 7 + 1);
+  }
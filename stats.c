@@ -0,0 +1,279 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* C >= C99 required for SIZE_MAX */
+#include <stdint.h>
+#include <string.h>
+#include "align.h"
+#include "pool.h"
+#include "region.h"
+#include "stats.h"
+
+/*
+ * Counters are read by other threads merging them, so they are accessed
+ * atomically where that is possible.  Only the thread recording changes
+ * them, so a relaxed load and store suffices, without the cost of an atomic
+ * read-modify-write
+ */
+#if defined(__GNUC__) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7) || defined(__clang__))
+#define DStatsLoad(Object) __atomic_load_n((Object), __ATOMIC_RELAXED)
+#define DStatsStore(Object, Value) \
+  __atomic_store_n((Object), (Value), __ATOMIC_RELAXED)
+#else
+#define DStatsLoad(Object) (*(Object))
+#define DStatsStore(Object, Value) (*(Object) = (Value))
+#endif
+#define DStatsAdd(Object, Value) \
+  DStatsStore((Object), DStatsLoad(Object) + (Value))
+
+static size_t stats_bucket(size_t Value);
+
+void * StatsAllocHeadTail(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    void ** Tail
+  )
+  {
+    void * head;
+    struct tail_layout layout;
+
+    /* A failure of the system allocator is not a failure of the layout */
+    TailLayout(&layout, HeadSize, TailSize);
+    head = TailLayoutAlloc(&layout, Tail);
+    if (head || !layout.total_size)
+      StatsRecord(Stats, &layout, HeadAlign, TailAlign, 1);
+    return head;
+  }
+
+/*
+ * Used by StatsRecord.  Returns the bucket for Value: zero for less than
+ * 2, one for 2 to 3, two for 4 to 7 and so on, up to DStatsBuckets - 1
+ */
+static size_t stats_bucket(size_t Value)
+  {
+    size_t bucket;
+
+    for (bucket = 0; Value > 1 && bucket < DStatsBuckets - 1; ++bucket)
+      Value >>= 1;
+    return bucket;
+  }
+
+void StatsMerge(
+    struct align_stats * Total,
+    const struct align_stats * Stats
+  )
+  {
+    size_t i;
+    const struct stats_class * size_class;
+    struct stats_class * total;
+
+    Total->failures += DStatsLoad(&Stats->failures);
+    for (i = 0; i < DStatsBuckets; ++i)
+      {
+        Total->padding_histogram[i] +=
+          DStatsLoad(&Stats->padding_histogram[i]);
+        size_class = Stats->size_classes + i;
+        total = Total->size_classes + i;
+        total->count += DStatsLoad(&size_class->count);
+        total->over_aligned += DStatsLoad(&size_class->over_aligned);
+        total->over_padding += DStatsLoad(&size_class->over_padding);
+        total->padding += DStatsLoad(&size_class->padding);
+        total->total += DStatsLoad(&size_class->total);
+      }
+  }
+
+size_t StatsPaddingSize(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    struct tail_layout layout;
+
+    TailLayout(&layout, HeadSize, TailSize);
+    StatsRecord(Stats, &layout, HeadAlign, TailAlign, 1);
+    return layout.padding;
+  }
+
+void * StatsPoolAlloc(
+    struct align_stats * Stats,
+    struct pool * Pool,
+    void ** Tail
+  )
+  {
+    void * head;
+    struct tail_layout layout;
+
+    head = PoolAlloc(Pool, Tail);
+    if (head)
+      {
+        PoolGetLayout(Pool, &layout);
+        StatsRecord(Stats, &layout, 0, 0, 1);
+      }
+    return head;
+  }
+
+void StatsRecord(
+    struct align_stats * Stats,
+    const struct tail_layout * Layout,
+    size_t HeadAlign,
+    size_t TailAlign,
+    size_t Count
+  )
+  {
+    struct tail_layout actual;
+    size_t bucket;
+    size_t head_size;
+    size_t padding;
+    struct stats_class * size_class;
+    size_t tail_size;
+
+    if (!Layout->total_size)
+      {
+        DStatsAdd(&Stats->failures, Count);
+        return;
+      }
+
+    padding = Layout->padding;
+    bucket = padding ? stats_bucket(padding) + 1 : 0;
+    if (bucket > DStatsBuckets - 1)
+      bucket = DStatsBuckets - 1;
+    DStatsAdd(&Stats->padding_histogram[bucket], Count);
+
+    size_class = Stats->size_classes + stats_bucket(Layout->total_size);
+    DStatsAdd(&size_class->count, Count);
+    DStatsAdd(&size_class->padding, Count * padding);
+    DStatsAdd(&size_class->total, Count * Layout->total_size);
+
+    /* Would the actual alignments have needed less padding? */
+    if (!HeadAlign && !TailAlign)
+      return;
+    tail_size = Layout->total_size - Layout->tail_offset;
+    head_size = Layout->tail_offset - padding;
+    TailLayoutEx(&actual, head_size, HeadAlign, tail_size, TailAlign);
+    if (actual.total_size && actual.padding < padding)
+      {
+        DStatsAdd(&size_class->over_aligned, Count);
+        DStatsAdd(
+            &size_class->over_padding,
+            Count * (padding - actual.padding)
+          );
+      }
+  }
+
+size_t StatsRegionInit(
+    struct align_stats * Stats,
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Count,
+    size_t StrideAlign,
+    int Flags
+  )
+  {
+    struct tail_layout layout;
+    size_t stride;
+
+    stride = RegionInit(
+        Region,
+        HeadSize,
+        TailSize,
+        Count,
+        StrideAlign,
+        Flags
+      );
+    if (stride)
+      {
+        RegionGetLayout(Region, &layout);
+        StatsRecord(Stats, &layout, 0, 0, Count);
+      }
+    return stride;
+  }
+
+void StatsReset(struct align_stats * Stats)
+  {
+    size_t i;
+    struct stats_class * size_class;
+
+    DStatsStore(&Stats->failures, 0);
+    for (i = 0; i < DStatsBuckets; ++i)
+      {
+        DStatsStore(&Stats->padding_histogram[i], 0);
+        size_class = Stats->size_classes + i;
+        DStatsStore(&size_class->count, 0);
+        DStatsStore(&size_class->over_aligned, 0);
+        DStatsStore(&size_class->over_padding, 0);
+        DStatsStore(&size_class->padding, 0);
+        DStatsStore(&size_class->total, 0);
+      }
+  }
+
+void StatsSnapshot(
+    struct align_stats * Snapshot,
+    const struct align_stats * const * Stats,
+    size_t Count
+  )
+  {
+    size_t i;
+
+    memset(Snapshot, 0, sizeof *Snapshot);
+    for (i = 0; i < Count; ++i)
+      StatsMerge(Snapshot, Stats[i]);
+  }
+
+size_t StatsTailAlignedSize(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  )
+  {
+    struct tail_layout layout;
+
+    TailLayout(&layout, HeadSize, TailSize);
+    StatsRecord(Stats, &layout, HeadAlign, TailAlign, 1);
+    return layout.total_size;
+  }
@@ -0,0 +1,189 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_stats
+#define DIncluded_stats 1
+#include <stddef.h>
+#include "align.h"
+#include "pool.h"
+#include "region.h"
+/* Buckets in each histogram of struct align_stats */
+#define DStatsBuckets 16
+
+/* Counters for the layouts of one size class */
+struct stats_class
+  {
+    /* Records laid out */
+    size_t count;
+    /*
+     * Records whose inferred alignment, from LargestPowerOfTwoFactor, led
+     * to more padding than their actual alignments needed
+     */
+    size_t over_aligned;
+    /* Bytes of padding that the actual alignments would not have needed */
+    size_t over_padding;
+    /* Bytes of padding between heads and tails */
+    size_t padding;
+    /* Bytes of storage, including the padding */
+    size_t total;
+  };
+
+/*
+ * Counters for the padding of head and tail layouts.  Each thread should
+ * record into its own, so that recording needs no locks nor atomic
+ * read-modify-write operations, and they can be merged when wanted.  A
+ * call-site of interest can have its own, too.  All zero bytes is a valid,
+ * empty state, as is the state after StatsReset
+ */
+struct align_stats
+  {
+    /* Layouts which could not be computed, as for sizes too large */
+    size_t failures;
+    /*
+     * Records by the bytes of padding: none, then 1, 2 to 3, 4 to 7 and so
+     * on, with the last bucket for anything more
+     */
+    size_t padding_histogram[DStatsBuckets];
+    /*
+     * Records by total size: less than 2, then 2 to 3, 4 to 7 and so on,
+     * with the last class for anything more
+     */
+    struct stats_class size_classes[DStatsBuckets];
+  };
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * As AllocHeadTail, also recording the layout into Stats.  HeadAlign and
+ * TailAlign are the actual alignments, or zero if not known, for recording
+ * over-alignment
+ */
+extern void * StatsAllocHeadTail(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign,
+    void ** Tail
+  );
+/*
+ * Adds the counters of Stats to those of Total.  Stats may be in use by
+ * another thread, in which case its latest few records might be missed
+ */
+extern void StatsMerge(
+    struct align_stats * Total,
+    const struct align_stats * Stats
+  );
+/*
+ * As PaddingSize, also recording the layout into Stats, with the alignments
+ * of StatsAllocHeadTail
+ */
+extern size_t StatsPaddingSize(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+/*
+ * As PoolAlloc, also recording the layout of the record into Stats.  For
+ * the caches of a pool, each thread can take the layout once with
+ * PoolGetLayout and record each allocation with StatsRecord
+ */
+extern void * StatsPoolAlloc(
+    struct align_stats * Stats,
+    struct pool * Pool,
+    void ** Tail
+  );
+/*
+ * Records Count records of the head and tail layout from TailLayout,
+ * TailLayoutEx or TailLayoutRounded into Stats, with the alignments of
+ * StatsAllocHeadTail.  A layout with a total size of zero is recorded as a
+ * failure.  Stats must only be recorded into by one thread at a time
+ */
+extern void StatsRecord(
+    struct align_stats * Stats,
+    const struct tail_layout * Layout,
+    size_t HeadAlign,
+    size_t TailAlign,
+    size_t Count
+  );
+/* As RegionInit, also recording the layouts of the records into Stats */
+extern size_t StatsRegionInit(
+    struct align_stats * Stats,
+    struct region * Region,
+    size_t HeadSize,
+    size_t TailSize,
+    size_t Count,
+    size_t StrideAlign,
+    int Flags
+  );
+/*
+ * Zeroes the counters of Stats.  Only the thread recording into Stats may
+ * do this, or another thread while none is recording.  An exporter sharing
+ * Stats can instead report the differences between snapshots
+ */
+extern void StatsReset(struct align_stats * Stats);
+/*
+ * Stores into Snapshot the sum of the counters of Count per-thread Stats,
+ * which may be in use, as for StatsMerge
+ */
+extern void StatsSnapshot(
+    struct align_stats * Snapshot,
+    const struct align_stats * const * Stats,
+    size_t Count
+  );
+/*
+ * As TailAlignedSize, also recording the layout into Stats, with the
+ * alignments of StatsAllocHeadTail
+ */
+extern size_t StatsTailAlignedSize(
+    struct align_stats * Stats,
+    size_t HeadSize,
+    size_t HeadAlign,
+    size_t TailSize,
+    size_t TailAlign
+  );
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_stats */
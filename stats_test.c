@@ -0,0 +1,424 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A test of the counters of stats.c.  Threads record layouts into counters
+ * of their own, through the wrappers of stats.c, while the main thread
+ * takes snapshots of them all.  The totals are then checked against the
+ * padding that PaddingSize and PaddingSizeEx report.  The buckets, merging,
+ * resetting and the pool and region wrappers are checked by the main
+ * thread alone.  Build it with threads, and with ThreadSanitizer where
+ * available:
+ *
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -O1 -pthread \
+ *     -fsanitize=thread -o stats_test align.c pool.c region.c stats.c \
+ *     stats_test.c -latomic
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "align.h"
+#include "pool.h"
+#include "region.h"
+#include "stats.h"
+
+/* Threads recording */
+#define DTestThreads 4
+/* Layouts recorded by each thread */
+#define DTestRounds 5000
+/* One layout in so many has a head of zero bytes, so it fails */
+#define DTestFailEvery 50
+/* Records from the pool and the region of the single-thread checks */
+#define DTestRecords 10
+
+/* The sums of the counters of a struct align_stats */
+struct totals
+  {
+    size_t failures;
+    /* Records in the padding histogram */
+    size_t histogram;
+    size_t over_aligned;
+    size_t over_padding;
+    size_t padding;
+    /* Records in the size classes */
+    size_t records;
+    size_t total;
+  };
+
+/* What each thread is doing */
+struct worker
+  {
+    /* What its counters should add up to */
+    struct totals expected;
+    /* Non-zero if a check failed */
+    int failed;
+    pthread_t handle;
+    unsigned long number;
+    struct align_stats stats;
+  };
+
+static int check_buckets(void);
+static int check_totals(
+    const char * What,
+    const struct totals * Totals,
+    const struct totals * Expected
+  );
+static int check_wrappers(void);
+static void * run_worker(void * Argument);
+static void sum_stats(const struct align_stats * Stats, struct totals * Sums);
+
+int main(void)
+  {
+    struct totals expected;
+    int failed;
+    size_t i;
+    struct align_stats merged;
+    struct align_stats snapshot;
+    const struct align_stats * stats[DTestThreads];
+    struct totals sums;
+    struct worker workers[DTestThreads];
+    struct align_stats zero;
+
+    failed = check_buckets() || check_wrappers();
+    for (i = 0; i < DTestThreads; ++i)
+      {
+        memset(workers + i, 0, sizeof workers[i]);
+        workers[i].number = (unsigned long) i + 1;
+        stats[i] = &workers[i].stats;
+        if (pthread_create(&workers[i].handle, NULL, run_worker, workers + i))
+          {
+            fprintf(stderr, "stats_test: pthread_create failed\n");
+            return EXIT_FAILURE;
+          }
+      }
+
+    /* Snapshots of counters in use may miss records, but never add any */
+    for (i = 0; i < 100; ++i)
+      {
+        StatsSnapshot(&snapshot, stats, DTestThreads);
+        sum_stats(&snapshot, &sums);
+        if (sums.records + sums.failures > DTestThreads * DTestRounds)
+          {
+            fprintf(stderr, "stats_test: a snapshot counted too much\n");
+            failed = 1;
+            break;
+          }
+      }
+
+    memset(&expected, 0, sizeof expected);
+    for (i = 0; i < DTestThreads; ++i)
+      {
+        pthread_join(workers[i].handle, NULL);
+        failed |= workers[i].failed;
+        expected.failures += workers[i].expected.failures;
+        expected.histogram += workers[i].expected.histogram;
+        expected.over_aligned += workers[i].expected.over_aligned;
+        expected.over_padding += workers[i].expected.over_padding;
+        expected.padding += workers[i].expected.padding;
+        expected.records += workers[i].expected.records;
+        expected.total += workers[i].expected.total;
+      }
+    StatsSnapshot(&snapshot, stats, DTestThreads);
+    sum_stats(&snapshot, &sums);
+    failed |= check_totals("the snapshot", &sums, &expected);
+
+    /* Merging the snapshot into a copy of it doubles it */
+    merged = snapshot;
+    StatsMerge(&merged, &snapshot);
+    sum_stats(&merged, &sums);
+    expected.failures *= 2;
+    expected.histogram *= 2;
+    expected.over_aligned *= 2;
+    expected.over_padding *= 2;
+    expected.padding *= 2;
+    expected.records *= 2;
+    expected.total *= 2;
+    failed |= check_totals("the merge", &sums, &expected);
+
+    memset(&zero, 0, sizeof zero);
+    StatsReset(&merged);
+    if (memcmp(&merged, &zero, sizeof zero))
+      {
+        fprintf(stderr, "stats_test: StatsReset left counts behind\n");
+        failed = 1;
+      }
+
+    if (failed)
+      return EXIT_FAILURE;
+    printf("stats_test: ok\n");
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * Returns non-zero, after complaining, if StatsRecord does not count known
+ * layouts in the right buckets and classes, times the count, with their
+ * over-alignment, or does not count a layout of no size as a failure
+ */
+static int check_buckets(void)
+  {
+    struct tail_layout layout;
+    struct align_stats stats;
+    const struct stats_class * size_class;
+
+    memset(&stats, 0, sizeof stats);
+
+    /* 7 bytes of padding, in 16 bytes: histogram bucket 3 and class 4 */
+    TailLayout(&layout, 8, 1);
+    StatsRecord(&stats, &layout, 0, 0, 5);
+    size_class = stats.size_classes + 4;
+    if (stats.padding_histogram[3] != 5 || size_class->count != 5 ||
+      size_class->padding != 35 || size_class->total != 80 ||
+      size_class->over_aligned)
+      {
+        fprintf(stderr, "stats_test: a layout was counted wrongly\n");
+        return 1;
+      }
+
+    /*
+     * 2 bytes and then 8 take 16 bytes as inferred, with 6 of padding, but
+     * only 10 if their alignments are actually 1 and 2
+     */
+    TailLayout(&layout, 2, 8);
+    StatsRecord(&stats, &layout, 1, 2, 1);
+    if (stats.padding_histogram[3] != 6 || size_class->count != 6 ||
+      size_class->over_aligned != 1 || size_class->over_padding != 6)
+      {
+        fprintf(stderr, "stats_test: over-alignment was counted wrongly\n");
+        return 1;
+      }
+
+    TailLayout(&layout, 0, 8);
+    StatsRecord(&stats, &layout, 0, 0, 3);
+    if (stats.failures != 3 || stats.padding_histogram[0])
+      {
+        fprintf(stderr, "stats_test: a failure was counted wrongly\n");
+        return 1;
+      }
+    return 0;
+  }
+
+/*
+ * Returns non-zero, after complaining about What, if Totals differ from
+ * Expected
+ */
+static int check_totals(
+    const char * What,
+    const struct totals * Totals,
+    const struct totals * Expected
+  )
+  {
+    if (Totals->failures == Expected->failures &&
+      Totals->histogram == Expected->histogram &&
+      Totals->over_aligned == Expected->over_aligned &&
+      Totals->over_padding == Expected->over_padding &&
+      Totals->padding == Expected->padding &&
+      Totals->records == Expected->records &&
+      Totals->total == Expected->total)
+      return 0;
+    fprintf(stderr, "stats_test: %s does not add up\n", What);
+    return 1;
+  }
+
+/*
+ * Returns non-zero, after complaining, if StatsPoolAlloc and
+ * StatsRegionInit do not record the layouts of their records
+ */
+static int check_wrappers(void)
+  {
+    void * heads[DTestRecords];
+    size_t i;
+    struct tail_layout layout;
+    struct pool pool;
+    struct region region;
+    struct align_stats stats;
+    struct totals sums;
+
+    memset(&stats, 0, sizeof stats);
+    if (!PoolInit(&pool, 24, 40, 0))
+      {
+        fprintf(stderr, "stats_test: PoolInit failed\n");
+        return 1;
+      }
+    PoolGetLayout(&pool, &layout);
+    for (i = 0; i < DTestRecords; ++i)
+      heads[i] = StatsPoolAlloc(&stats, &pool, NULL);
+    for (i = 0; i < DTestRecords; ++i)
+      PoolFree(&pool, heads[i]);
+    PoolDestroy(&pool);
+    sum_stats(&stats, &sums);
+    if (sums.records != DTestRecords ||
+      sums.padding != DTestRecords * layout.padding ||
+      sums.total != DTestRecords * layout.total_size)
+      {
+        fprintf(stderr, "stats_test: StatsPoolAlloc was not counted\n");
+        return 1;
+      }
+
+    StatsReset(&stats);
+    if (!StatsRegionInit(&stats, &region, 12, 20, DTestRecords, 64, 0))
+      {
+        fprintf(stderr, "stats_test: StatsRegionInit failed\n");
+        return 1;
+      }
+    RegionGetLayout(&region, &layout);
+    RegionDestroy(&region);
+    sum_stats(&stats, &sums);
+    if (sums.records != DTestRecords ||
+      sums.padding != DTestRecords * layout.padding ||
+      sums.total != DTestRecords * layout.total_size)
+      {
+        fprintf(stderr, "stats_test: StatsRegionInit was not counted\n");
+        return 1;
+      }
+    return 0;
+  }
+
+/*
+ * Records layouts of varied sizes and alignments into counters of its own,
+ * through each of the wrappers in turn, tallying what they should add up
+ * to from PaddingSize and PaddingSizeEx
+ */
+static void * run_worker(void * Argument)
+  {
+    size_t actual;
+    size_t head_align;
+    size_t head_size;
+    void * head;
+    size_t padding;
+    size_t round;
+    size_t tail_align;
+    size_t tail_size;
+    size_t total;
+    struct worker * worker;
+
+    worker = Argument;
+    for (round = 0; round < DTestRounds; ++round)
+      {
+        head_size = round % DTestFailEvery ?
+          1 + (round * 7 + worker->number * 13) % 64 :
+          0;
+        tail_size = 1 + (round * 11 + worker->number) % 64;
+
+        /* Actual alignments no stricter than inferred, and often less */
+        head_align = LargestPowerOfTwoFactor(head_size) >> round % 3;
+        tail_align = LargestPowerOfTwoFactor(tail_size) >> round % 2;
+        if (!head_align)
+          head_align = 1;
+        if (!tail_align)
+          tail_align = 1;
+
+        switch (round % 3)
+          {
+            case 0:
+              total = StatsTailAlignedSize(
+                  &worker->stats,
+                  head_size,
+                  head_align,
+                  tail_size,
+                  tail_align
+                );
+              worker->failed |= total != TailAlignedSize(head_size, tail_size);
+              break;
+            case 1:
+              padding = StatsPaddingSize(
+                  &worker->stats,
+                  head_size,
+                  head_align,
+                  tail_size,
+                  tail_align
+                );
+              worker->failed |= padding != PaddingSize(head_size, tail_size);
+              break;
+            default:
+              head = StatsAllocHeadTail(
+                  &worker->stats,
+                  head_size,
+                  head_align,
+                  tail_size,
+                  tail_align,
+                  NULL
+                );
+              worker->failed |= !head != !head_size;
+              FreeHeadTail(head);
+          }
+
+        total = TailAlignedSize(head_size, tail_size);
+        if (!total)
+          {
+            ++worker->expected.failures;
+            continue;
+          }
+        padding = PaddingSize(head_size, tail_size);
+        actual = PaddingSizeEx(head_size, head_align, tail_size, tail_align);
+        ++worker->expected.histogram;
+        ++worker->expected.records;
+        worker->expected.padding += padding;
+        worker->expected.total += total;
+        if (actual < padding)
+          {
+            ++worker->expected.over_aligned;
+            worker->expected.over_padding += padding - actual;
+          }
+      }
+    if (worker->failed)
+      fprintf(stderr, "stats_test: a wrapper changed a result\n");
+    return NULL;
+  }
+
+/* Adds up the counters of Stats into Sums */
+static void sum_stats(const struct align_stats * Stats, struct totals * Sums)
+  {
+    size_t i;
+    const struct stats_class * size_class;
+
+    memset(Sums, 0, sizeof *Sums);
+    Sums->failures = Stats->failures;
+    for (i = 0; i < DStatsBuckets; ++i)
+      {
+        size_class = Stats->size_classes + i;
+        Sums->histogram += Stats->padding_histogram[i];
+        Sums->over_aligned += size_class->over_aligned;
+        Sums->over_padding += size_class->over_padding;
+        Sums->padding += size_class->padding;
+        Sums->records += size_class->count;
+        Sums->total += size_class->total;
+      }
+  }
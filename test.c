@@ -39,11 +39,39 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "align.h"
+#include "layout.h"
 
+/* Random heads and arrays laid out by the TailArray functions */
+#define DArraySets 1000
+/* Random pairs of sizes allocated by AllocHeadTail */
+#define DAllocSets 200
+/* The most pairs in each batch, for every remainder after the vectors */
+#define DBatchMax 19
+/* Random batches checked against one pair at a time */
+#define DBatchSets 400
 #define DCountOf(arr) (sizeof (arr) / sizeof *(arr))
+/* Random pairs of sizes and alignments for the Ex functions */
+#define DExplicitSets 1000
+/* Random sets of members checked against every ordering of them */
+#define DLayoutSets 300
+/* The most members in each, for 7! orderings */
+#define DLayoutSetMax 7
+/* Random sets of objects checked against a naive layout of them */
+#define DMultiSets 1000
+/* The most objects in each */
+#define DMultiSetMax 8
 #define DQuote(x) # x
 #define DSizeDesc(type) { sizeof (type), DQuote(type) }
+/* Random arrays sorted by each function, beyond those sorted in place */
+#define DSortSets 120
+/* The most elements in each */
+#define DSortMax 100
+/* Random pairs of sizes laid out by TailLayoutRounded */
+#define DRoundedSets 1000
+/* Random pairs of sizes given strides by TailAlignedStride */
+#define DStrideSets 1000
 
 struct size_desc
   {
@@ -51,8 +79,63 @@ struct size_desc
     const char * name;
   };
 
+/* An element for check_sort, remembering where it was before sorting */
+struct sort_element
+  {
+    size_t size;
+    size_t align;
+    size_t index;
+  };
+
+static size_t best_size(
+    const struct layout_member * members,
+    size_t * order,
+    const size_t count,
+    const size_t fixed
+  );
+static int check_alloc(void);
+static int check_array(void);
+static int check_batch(void);
+static int check_batch32(void);
+static int check_columns(void);
+static int check_explicit(void);
+static int check_grouped(void);
+static int check_hot(void);
+static int check_layout(void);
+static int check_multi(void);
+static int check_multi_set(
+    const size_t * sizes,
+    const size_t * aligns,
+    const size_t count
+  );
+static int check_placement(
+    const struct layout_member * members,
+    const size_t count,
+    const size_t * order,
+    const size_t * offsets,
+    const size_t total,
+    const size_t set
+  );
+static int check_rounded(void);
+static int check_sort(void);
+static int check_stride(void);
 static size_t max_factor(const struct size_desc * sizes, const size_t count);
+static size_t member_align(const struct layout_member * member);
+static size_t next_random(const size_t limit);
+static size_t placed_size(
+    const struct layout_member * members,
+    const size_t * order,
+    const size_t count
+  );
+static int precedes(
+    const struct sort_element * first,
+    const struct sort_element * second,
+    const int by_alignment,
+    const int explicit_align
+  );
 static void print_order(const struct size_desc * sizes, const size_t count);
+static size_t random_members(struct layout_member * members);
+static size_t random_size(const size_t max);
 static void show_padding1(const struct size_desc * sizes, const size_t count);
 static void show_padding2(const struct size_desc * sizes, const size_t count);
 
@@ -108,9 +191,1328 @@ int main(void)
         show_padding2(test->first, test->cnt);
       }
 
+    if (!check_layout() || !check_multi() || !check_batch() ||
+      !check_batch32() || !check_alloc() || !check_sort() ||
+      !check_explicit() || !check_hot() || !check_grouped() ||
+      !check_columns() || !check_array() || !check_stride() ||
+      !check_rounded())
+      return EXIT_FAILURE;
     return EXIT_SUCCESS;
   }
 
+/*
+ * Returns the least size of the count members placed in any order whose
+ * first fixed positions are those of order, trying the rest by exchanges
+ */
+static size_t best_size(
+    const struct layout_member * members,
+    size_t * order,
+    const size_t count,
+    const size_t fixed
+  )
+  {
+    size_t best;
+    size_t i;
+    size_t size;
+    size_t swap;
+
+    if (fixed == count)
+      return placed_size(members, order, count);
+    for ((best = (size_t) -1), (i = fixed); i < count; ++i)
+      {
+        swap = order[fixed];
+        order[fixed] = order[i];
+        order[i] = swap;
+        size = best_size(members, order, count, fixed + 1);
+        if (size < best)
+          best = size;
+        order[i] = order[fixed];
+        order[fixed] = swap;
+      }
+    return best;
+  }
+
+/*
+ * Checks that AllocHeadTail and TailLayoutAlloc return storage for random
+ * pairs of sizes with the tail where TailLayout puts it, which is as
+ * aligned, relative to the head, as the tail needs, that heads and tails
+ * convert back and forth, and that sizes which are zero or too large
+ * allocate nothing.  Returns zero, after saying why, if any check fails
+ */
+static int check_alloc(void)
+  {
+    typedef unsigned int ui;
+    static const size_t bad[][2] =
+      {
+        { 0, 8 },
+        { 8, 0 },
+        { (size_t) -1, 1 },
+        { (size_t) -1 / 2 + 1, (size_t) -1 / 2 + 1 }
+      };
+    size_t align;
+    char * head;
+    size_t head_size;
+    struct tail_layout layout;
+    size_t set;
+    void * tail;
+    size_t tail_size;
+
+    printf("--- AllocHeadTail ---\n\n");
+    for (set = 0; set < DAllocSets; ++set)
+      {
+        head_size = 1 + next_random(100);
+        tail_size = 1 + next_random(100);
+        align = (size_t) 1 << next_random(5);
+        tail_size = (tail_size + align - 1) & ~(align - 1);
+
+        /* Every other pair with an explicit tail alignment */
+        if (set % 2)
+          {
+            TailLayoutEx(&layout, head_size, 0, tail_size, align);
+            head = TailLayoutAlloc(&layout, &tail);
+          }
+          else
+          {
+            align = LargestPowerOfTwoFactor(tail_size);
+            TailLayout(&layout, head_size, tail_size);
+            head = AllocHeadTail(head_size, tail_size, &tail);
+          }
+        if (!head || tail != head + layout.tail_offset ||
+          layout.tail_offset % align ||
+          layout.tail_offset < head_size ||
+          layout.tail_offset + tail_size != layout.total_size ||
+          HeadFromTail(tail, &layout) != head ||
+          TailFromHead(head, &layout) != tail)
+          {
+            printf(
+                "Pair %u: %u and %u bytes are misplaced\n",
+                (ui) set,
+                (ui) head_size,
+                (ui) tail_size
+              );
+            FreeHeadTail(head);
+            return 0;
+          }
+
+        /* Where a sanitizer would see it overrun */
+        memset(head, 0, head_size);
+        memset(tail, 0, tail_size);
+        FreeHeadTail(head);
+      }
+
+    for (set = 0; set < DCountOf(bad); ++set)
+      {
+        tail = &layout;
+        head = AllocHeadTail(bad[set][0], bad[set][1], &tail);
+        if (head || tail)
+          {
+            printf("Bad pair %u: allocated\n", (ui) set);
+            FreeHeadTail(head);
+            return 0;
+          }
+      }
+    TailLayoutEx(&layout, 8, 3, 8, 0);
+    tail = &layout;
+    if (TailLayoutAlloc(&layout, &tail) || tail)
+      {
+        printf("A bad alignment: allocated\n");
+        return 0;
+      }
+    FreeHeadTail(NULL);
+    printf(
+        "%u random pairs: allocated, aligned and converted\n\n",
+        (ui) DAllocSets
+      );
+    return 1;
+  }
+
+/*
+ * Checks TailArrayOffset, TailArraySize and TailArrayCapacity for random
+ * heads and arrays, rounded up to nothing, a cache line or a page: that
+ * the array is aligned after the head, that the total is as little as the
+ * rounding allows, and that the capacity fills the total and sizes it
+ * again.  Then checks that bad parameters and sizes which are too large
+ * give zero.  Returns zero, after saying why, if any check fails
+ */
+static int check_array(void)
+  {
+    typedef unsigned int ui;
+    static const size_t bad[][6] =
+      {
+        { 0, 0, 8, 0, 1, 0 },
+        { 8, 3, 8, 0, 1, 0 },
+        { 8, 0, 12, 8, 1, 0 },
+        { 8, 0, 8, 0, 1, 48 },
+        { 8, 0, 8, 0, (size_t) -1 / 8, 0 },
+        { 8, 0, 8, 0, (size_t) -1 / 8 - 1, DAlignHugePageSize }
+      };
+    size_t align;
+    size_t capacity;
+    size_t count;
+    size_t element_align;
+    size_t element_size;
+    size_t end;
+    size_t factor;
+    size_t head_align;
+    size_t head_size;
+    size_t offset;
+    const size_t * row;
+    size_t round_to;
+    size_t set;
+    size_t total;
+
+    printf("--- TailArraySize ---\n\n");
+    for (set = 0; set < DArraySets; ++set)
+      {
+        head_size = 1 + next_random(100);
+        head_align = next_random(2) ? (size_t) 1 << next_random(7) : 0;
+        element_size = 1 + next_random(40);
+        align = next_random(2) ? (size_t) 1 << next_random(5) : 0;
+        if (align)
+          element_size = (element_size + align - 1) & ~(align - 1);
+        count = next_random(50);
+        round_to = set % 3 ? (set % 3 == 1 ? 64 : DAlignPageSize) : 0;
+
+        /* The strictest of the alignments and the rounding */
+        factor = head_align ? head_align : LargestPowerOfTwoFactor(head_size);
+        element_align = align ? align : LargestPowerOfTwoFactor(element_size);
+        if (element_align > factor)
+          factor = element_align;
+        if (round_to > factor)
+          factor = round_to;
+
+        offset = TailArrayOffset(head_size, head_align, element_size, align);
+        total = TailArraySize(
+            head_size,
+            head_align,
+            element_size,
+            align,
+            count,
+            round_to
+          );
+        end = offset + count * element_size;
+        if (offset < head_size || offset - head_size >= element_align ||
+          offset % element_align || total < end || total % factor ||
+          total - end >= factor)
+          {
+            printf(
+                "Set %u: %u elements of %u after %u bytes, misplaced\n",
+                (ui) set,
+                (ui) count,
+                (ui) element_size,
+                (ui) head_size
+              );
+            return 0;
+          }
+
+        capacity = TailArrayCapacity(
+            total,
+            head_size,
+            head_align,
+            element_size,
+            align
+          );
+        if (capacity < count ||
+          offset + capacity * element_size > total ||
+          offset + (capacity + 1) * element_size <= total ||
+          TailArraySize(
+              head_size,
+              head_align,
+              element_size,
+              align,
+              capacity,
+              round_to
+            ) != total)
+          {
+            printf(
+                "Set %u: a capacity of %u in %u bytes\n",
+                (ui) set,
+                (ui) capacity,
+                (ui) total
+              );
+            return 0;
+          }
+      }
+
+    for (set = 0; set < DCountOf(bad); ++set)
+      {
+        row = bad[set];
+        if (TailArraySize(row[0], row[1], row[2], row[3], row[4], row[5]) ||
+          (set < 3 &&
+            (TailArrayOffset(row[0], row[1], row[2], row[3]) ||
+              TailArrayCapacity(4096, row[0], row[1], row[2], row[3]))))
+          {
+            printf("Bad array %u: not refused\n", (ui) set);
+            return 0;
+          }
+      }
+    if (TailArrayCapacity(15, 16, 0, 8, 0))
+      {
+        printf("A capacity before the array begins\n");
+        return 0;
+      }
+    printf(
+        "%u random heads and arrays: as rounded, to capacity\n\n",
+        (ui) DArraySets
+      );
+    return 1;
+  }
+
+/*
+ * Checks TailAlignedSizeBatch, whose vectors are only used for whole
+ * groups of pairs, against TailAlignedSize for random batches of every
+ * length up to DBatchMax, with sizes which are zero or overflow among
+ * them.  Returns zero, after saying why, if any check fails
+ */
+static int check_batch(void)
+  {
+    typedef unsigned int ui;
+    size_t count;
+    size_t expected[DBatchMax];
+    size_t heads[DBatchMax + 1];
+    size_t i;
+    size_t out[DBatchMax + 1];
+    size_t * results;
+    size_t set;
+    size_t tails[DBatchMax];
+
+    printf("--- TailAlignedSizeBatch ---\n\n");
+    for (set = 0; set < DBatchSets; ++set)
+      {
+        count = set % (DBatchMax + 1);
+        for (i = 0; i < count; ++i)
+          {
+            heads[i] = random_size((size_t) -1);
+            tails[i] = random_size((size_t) -1);
+            expected[i] = TailAlignedSize(heads[i], tails[i]);
+          }
+
+        /* Every other batch is stored over its heads, as is allowed */
+        results = set % 2 ? heads : out;
+        results[count] = 1;
+        TailAlignedSizeBatch(heads, tails, results, count);
+        for (i = 0; i < count; ++i)
+          {
+            if (results[i] != expected[i])
+              {
+                printf(
+                    "Batch %u: pair %u differs from TailAlignedSize\n",
+                    (ui) set,
+                    (ui) i
+                  );
+                return 0;
+              }
+          }
+        if (results[count] != 1)
+          {
+            printf("Batch %u: stored beyond the count\n", (ui) set);
+            return 0;
+          }
+      }
+
+    out[0] = 1;
+    TailAlignedSizeBatch(NULL, tails, out, 1);
+    if (out[0] != 1)
+      {
+        printf("A batch without heads was stored\n");
+        return 0;
+      }
+    printf(
+        "%u random batches of up to %u pairs: as TailAlignedSize\n\n",
+        (ui) DBatchSets,
+        (ui) DBatchMax
+      );
+    return 1;
+  }
+
+/*
+ * As check_batch, for TailAlignedSizeBatch32 against TailAlignedSize32,
+ * and also checks that those results are the same as TailAlignedSize,
+ * wherever they fit, for sizes whose factors are no more than 2^30
+ */
+static int check_batch32(void)
+  {
+    typedef unsigned int ui;
+    size_t count;
+    uint32_t expected[DBatchMax];
+    uint32_t heads[DBatchMax + 1];
+    size_t i;
+    uint32_t out[DBatchMax + 1];
+    uint32_t * results;
+    size_t set;
+    uint32_t tails[DBatchMax];
+    size_t total;
+
+    printf("--- TailAlignedSizeBatch32 ---\n\n");
+    for (set = 0; set < DBatchSets; ++set)
+      {
+        count = set % (DBatchMax + 1);
+        for (i = 0; i < count; ++i)
+          {
+            heads[i] = (uint32_t) random_size((uint32_t) -1);
+            tails[i] = (uint32_t) random_size((uint32_t) -1);
+            expected[i] = TailAlignedSize32(heads[i], tails[i]);
+            if (LargestPowerOfTwoFactor(heads[i]) <= DMaxPowerOfTwoFactor32 &&
+              LargestPowerOfTwoFactor(tails[i]) <= DMaxPowerOfTwoFactor32)
+              {
+                total = TailAlignedSize(heads[i], tails[i]);
+                if (expected[i] != (total > (uint32_t) -1 ? 0 : total))
+                  {
+                    printf(
+                        "Batch %u: pair %u differs from TailAlignedSize\n",
+                        (ui) set,
+                        (ui) i
+                      );
+                    return 0;
+                  }
+              }
+          }
+
+        results = set % 2 ? heads : out;
+        results[count] = 1;
+        TailAlignedSizeBatch32(heads, tails, results, count);
+        for (i = 0; i < count; ++i)
+          {
+            if (results[i] != expected[i])
+              {
+                printf(
+                    "Batch %u: pair %u differs from TailAlignedSize32\n",
+                    (ui) set,
+                    (ui) i
+                  );
+                return 0;
+              }
+          }
+        if (results[count] != 1)
+          {
+            printf("Batch %u: stored beyond the count\n", (ui) set);
+            return 0;
+          }
+      }
+    printf(
+        "%u random batches of up to %u pairs: as TailAlignedSize32\n\n",
+        (ui) DBatchSets,
+        (ui) DBatchMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks that LayoutColumns places a column for each of random sets of
+ * members, with random element counts and vector alignments, at an offset
+ * aligned for both, with no column nor the padding at its end reaching
+ * another, and that its result describes the layout.  Then checks that a
+ * vector alignment which is not a power of two is refused.  Returns zero,
+ * after saying why, if any check fails
+ */
+static int check_columns(void)
+  {
+    typedef unsigned int ui;
+    size_t align;
+    size_t count;
+    size_t elements;
+    size_t ends[DLayoutSetMax];
+    size_t i;
+    size_t j;
+    size_t max;
+    struct layout_member members[DLayoutSetMax];
+    size_t offsets[DLayoutSetMax];
+    struct layout_column_result result;
+    size_t set;
+    size_t sum;
+    size_t total;
+    size_t vector;
+
+    printf("--- LayoutColumns ---\n\n");
+    for (set = 0; set < DLayoutSets; ++set)
+      {
+        count = random_members(members);
+        elements = 1 + next_random(20);
+        vector = next_random(2) ? (size_t) 8 << next_random(4) : 0;
+        total = LayoutColumns(
+            members,
+            count,
+            elements,
+            vector,
+            offsets,
+            &result
+          );
+        for ((max = 1), (sum = 0), (i = 0); i < count; ++i)
+          {
+            align = member_align(members + i);
+            if (vector > align)
+              align = vector;
+            if (align > max)
+              max = align;
+            ends[i] = offsets[i] + elements * members[i].size;
+            ends[i] = (ends[i] + align - 1) & ~(align - 1);
+            sum += elements * members[i].size;
+            if (!total || offsets[i] % align || ends[i] > total)
+              {
+                printf("Set %u: column %u is misplaced\n", (ui) set, (ui) i);
+                return 0;
+              }
+            for (j = 0; j < i; ++j)
+              {
+                if (offsets[i] < ends[j] && offsets[j] < ends[i])
+                  {
+                    printf(
+                        "Set %u: columns %u and %u overlap\n",
+                        (ui) set,
+                        (ui) j,
+                        (ui) i
+                      );
+                    return 0;
+                  }
+              }
+          }
+        if (result.total_size != total || result.alignment != max ||
+          total % max || result.padding != total - sum)
+          {
+            printf(
+                "Set %u: the result does not describe the layout\n",
+                (ui) set
+              );
+            return 0;
+          }
+      }
+    if (LayoutColumns(members, 1, 1, 24, offsets, &result) ||
+      LayoutColumns(members, 1, 0, 0, offsets, &result))
+      {
+        printf("A bad vector alignment or no elements: not refused\n");
+        return 0;
+      }
+    printf(
+        "%u random sets of up to %u columns: aligned and apart\n\n",
+        (ui) DLayoutSets,
+        (ui) DLayoutSetMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks TailAlignedSizeEx, TailOffsetEx, PaddingSizeEx and TailLayoutEx
+ * against a layout with the given alignments, for random pairs of sizes
+ * whose alignments are often less or more strict than their sizes imply,
+ * and that alignments which are not powers of two, or do not divide the
+ * tail, are refused.  Then checks LayoutMembersDeclared likewise.  Returns
+ * zero, after saying why, if any check fails
+ */
+static int check_explicit(void)
+  {
+    typedef unsigned int ui;
+    static const size_t bad[][4] =
+      {
+        { 8, 3, 8, 0 },
+        { 8, 0, 8, 6 },
+        { 8, 0, 12, 8 },
+        { 0, 0, 8, 0 },
+        { (size_t) -1, 1, 1, 1 }
+      };
+    size_t count;
+    size_t end;
+    size_t factor;
+    size_t head_align;
+    size_t head_size;
+    size_t i;
+    struct tail_layout layout;
+    size_t max;
+    struct layout_member members[DLayoutSetMax];
+    size_t offset;
+    size_t offsets[DLayoutSetMax];
+    size_t order[DLayoutSetMax];
+    const size_t * pair;
+    size_t set;
+    size_t tail_align;
+    size_t tail_size;
+    size_t total;
+
+    printf("--- TailAlignedSizeEx and LayoutMembersDeclared ---\n\n");
+    printf(
+        "8 bytes aligned to 1, then 1 byte: %u bytes, not %u\n",
+        (ui) TailAlignedSizeEx(8, 1, 1, 0),
+        (ui) TailAlignedSize(8, 1)
+      );
+    for (set = 0; set < DExplicitSets; ++set)
+      {
+        head_size = 1 + next_random(100);
+        tail_size = 1 + next_random(100);
+        head_align = next_random(2) ? (size_t) 1 << next_random(7) : 0;
+        tail_align = next_random(2) ? (size_t) 1 << next_random(7) : 0;
+        if (tail_align)
+          tail_size = (tail_size + tail_align - 1) & ~(tail_align - 1);
+
+        /* The layout which the explicit alignments imply */
+        max = head_align ? head_align : LargestPowerOfTwoFactor(head_size);
+        factor = tail_align ? tail_align : LargestPowerOfTwoFactor(tail_size);
+        if (factor > max)
+          max = factor;
+        total = (head_size + tail_size + max - 1) & ~(max - 1);
+        offset = total - tail_size;
+
+        TailLayoutEx(&layout, head_size, head_align, tail_size, tail_align);
+        if (TailAlignedSizeEx(head_size, head_align, tail_size, tail_align) !=
+          total ||
+          TailOffsetEx(head_size, head_align, tail_size, tail_align) !=
+          offset ||
+          PaddingSizeEx(head_size, head_align, tail_size, tail_align) !=
+          offset - head_size ||
+          layout.total_size != total || layout.tail_offset != offset ||
+          layout.padding != offset - head_size || layout.alignment != max ||
+          layout.overflow)
+          {
+            printf(
+                "Pair %u: %u and %u bytes, aligned to %u and %u, misplaced\n",
+                (ui) set,
+                (ui) head_size,
+                (ui) tail_size,
+                (ui) head_align,
+                (ui) tail_align
+              );
+            return 0;
+          }
+      }
+    for (set = 0; set < DCountOf(bad); ++set)
+      {
+        pair = bad[set];
+        TailLayoutEx(&layout, pair[0], pair[1], pair[2], pair[3]);
+        if (TailAlignedSizeEx(pair[0], pair[1], pair[2], pair[3]) ||
+          TailOffsetEx(pair[0], pair[1], pair[2], pair[3]) ||
+          PaddingSizeEx(pair[0], pair[1], pair[2], pair[3]) != (size_t) -1 ||
+          layout.total_size || layout.padding != (size_t) -1 ||
+          (set < 3 && (layout.alignment || layout.overflow)) ||
+          (set == 4 && !layout.overflow))
+          {
+            printf("Bad pair %u: not refused\n", (ui) set);
+            return 0;
+          }
+      }
+
+    for (set = 0; set < DLayoutSets; ++set)
+      {
+        count = 1 + next_random(DLayoutSetMax);
+        for (i = 0; i < count; ++i)
+          {
+            members[i].size = 1 + next_random(24);
+            members[i].align = next_random(2) ?
+              (size_t) 1 << next_random(5) :
+              0;
+            members[i].weight = 0;
+            members[i].group = 0;
+            order[i] = i;
+          }
+        total = LayoutMembersDeclared(members, count, offsets);
+        for ((end = 0), (i = 0); i < count; ++i)
+          {
+            max = member_align(members + i);
+            end = (end + max - 1) & ~(max - 1);
+            if (offsets[i] != end)
+              {
+                printf(
+                    "Set %u: member %u is not where it was declared\n",
+                    (ui) set,
+                    (ui) i
+                  );
+                return 0;
+              }
+            end += members[i].size;
+          }
+        if (total != placed_size(members, order, count))
+          {
+            printf("Set %u: %u bytes, as declared\n", (ui) set, (ui) total);
+            return 0;
+          }
+      }
+    members[0].size = 8;
+    members[0].align = 3;
+    if (LayoutMembersDeclared(members, 1, offsets))
+      {
+        printf("A bad member alignment: not refused\n");
+        return 0;
+      }
+    printf(
+        "%u random pairs and %u random sets: as explicitly aligned\n\n",
+        (ui) DExplicitSets,
+        (ui) DLayoutSets
+      );
+    return 1;
+  }
+
+/*
+ * Checks that LayoutMembersGrouped places random sets of members, in a few
+ * groups, in a real layout in which members of different groups share no
+ * line, and that its result describes the layout.  Returns zero, after
+ * saying why, if any check fails
+ */
+static int check_grouped(void)
+  {
+    typedef unsigned int ui;
+    size_t count;
+    size_t first;
+    size_t groups;
+    size_t i;
+    size_t j;
+    size_t last;
+    size_t line;
+    struct layout_member members[DLayoutSetMax];
+    size_t offsets[DLayoutSetMax];
+    size_t order[DLayoutSetMax];
+    struct layout_group_result result;
+    size_t set;
+    size_t sum;
+    size_t total;
+
+    printf("--- LayoutMembersGrouped ---\n\n");
+    for (set = 0; set < DLayoutSets; ++set)
+      {
+        count = random_members(members);
+        for (i = 0; i < count; ++i)
+          members[i].group = next_random(3);
+        line = (size_t) 8 << next_random(4);
+        total = LayoutMembersGrouped(
+            members,
+            count,
+            line,
+            order,
+            offsets,
+            &result
+          );
+        if (!check_placement(members, count, order, offsets, total, set))
+          return 0;
+
+        for ((groups = 0), (sum = 0), (i = 0); i < count; ++i)
+          {
+            first = offsets[i] / line;
+            last = (offsets[i] + members[i].size - 1) / line;
+            for (j = 0; j < i; ++j)
+              {
+                if (members[j].group == members[i].group)
+                  break;
+              }
+            groups += j == i;
+            for (j = 0; j < i; ++j)
+              {
+                if (members[j].group != members[i].group &&
+                  first <= (offsets[j] + members[j].size - 1) / line &&
+                  offsets[j] / line <= last)
+                  {
+                    printf(
+                        "Set %u: members %u and %u share a line\n",
+                        (ui) set,
+                        (ui) j,
+                        (ui) i
+                      );
+                    return 0;
+                  }
+              }
+            sum += members[i].size;
+          }
+
+        if (result.total_size != total || total % line ||
+          total % result.alignment || result.lines != total / line ||
+          result.groups != groups || result.padding != total - sum)
+          {
+            printf(
+                "Set %u: the result does not describe the layout\n",
+                (ui) set
+              );
+            return 0;
+          }
+      }
+    printf(
+        "%u random sets of up to %u members: groups on lines apart\n\n",
+        (ui) DLayoutSets,
+        (ui) DLayoutSetMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks that LayoutMembersHot, with and without DLayoutSplit, places random
+ * sets of hot and cold members in a real layout in which no hot member
+ * crosses a line it need not, and that its result describes the layout.
+ * Returns zero, after saying why, if any check fails
+ */
+static int check_hot(void)
+  {
+    typedef unsigned int ui;
+    size_t cold_end;
+    size_t count;
+    int flags;
+    size_t hot_end;
+    size_t i;
+    size_t line;
+    size_t lines;
+    struct layout_member members[DLayoutSetMax];
+    size_t offsets[DLayoutSetMax];
+    size_t order[DLayoutSetMax];
+    struct layout_hot_result result;
+    size_t set;
+    size_t size;
+    size_t total;
+
+    printf("--- LayoutMembersHot ---\n\n");
+    for (set = 0; set < DLayoutSets; ++set)
+      {
+        count = random_members(members);
+        for (i = 0; i < count; ++i)
+          members[i].weight = next_random(2) ? 1 + next_random(4) : 0;
+        line = (size_t) 8 << next_random(4);
+        flags = next_random(2) ? DLayoutSplit : 0;
+        total = LayoutMembersHot(
+            members,
+            count,
+            line,
+            flags,
+            order,
+            offsets,
+            &result
+          );
+        if (!check_placement(members, count, order, offsets, total, set))
+          return 0;
+
+        /* Where the hot members end and where the cold ones begin */
+        hot_end = 0;
+        cold_end = total;
+        for (i = 0; i < count; ++i)
+          {
+            size = members[i].size;
+            if (members[i].weight &&
+              (size > line ?
+                offsets[i] % line :
+                offsets[i] / line != (offsets[i] + size - 1) / line))
+              {
+                printf(
+                    "Set %u: hot member %u crosses a line\n",
+                    (ui) set,
+                    (ui) i
+                  );
+                return 0;
+              }
+            if (members[i].weight && offsets[i] + size > hot_end)
+              hot_end = offsets[i] + size;
+            if (!members[i].weight && offsets[i] < cold_end)
+              cold_end = offsets[i];
+          }
+
+        /* Lines holding any part of a hot member */
+        for ((lines = 0), (size = 0); size < total; size += line)
+          {
+            for (i = 0; i < count; ++i)
+              {
+                if (members[i].weight && offsets[i] < size + line &&
+                  size < offsets[i] + members[i].size)
+                  break;
+              }
+            lines += i < count;
+          }
+
+        if (result.total_size != total || total % result.alignment ||
+          result.hot_lines != lines ||
+          (result.cold_offset &&
+            (hot_end > result.hot_size ||
+              result.hot_size > result.cold_offset ||
+              cold_end < result.cold_offset)) ||
+          (flags && hot_end && cold_end < total && !result.cold_offset))
+          {
+            printf(
+                "Set %u: the result does not describe the layout\n",
+                (ui) set
+              );
+            return 0;
+          }
+      }
+    printf(
+        "%u random sets of up to %u members: hot members within lines\n\n",
+        (ui) DLayoutSets,
+        (ui) DLayoutSetMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks LayoutMembers against every ordering of random sets of members,
+ * and checks that its order and offsets describe a real layout.  Returns
+ * zero, after saying why, if any check fails
+ */
+static int check_layout(void)
+  {
+    typedef unsigned int ui;
+    size_t best;
+    size_t count;
+    struct layout_member members[DLayoutSetMax];
+    size_t offsets[DLayoutSetMax];
+    size_t order[DLayoutSetMax];
+    struct layout_result result;
+    size_t set;
+    size_t total;
+
+    printf("--- LayoutMembers ---\n\n");
+    for (set = 0; set < DLayoutSets; ++set)
+      {
+        count = random_members(members);
+
+        total = LayoutMembers(members, count, order, offsets, &result);
+        if (!check_placement(members, count, order, offsets, total, set))
+          return 0;
+
+        best = best_size(members, order, count, 0);
+        if (!total || total != result.total_size ||
+          total != placed_size(members, order, count) ||
+          total % result.alignment || result.lower_bound > total ||
+          total != best)
+          {
+            printf(
+                "Set %u: total size %u, but the best is %u\n",
+                (ui) set,
+                (ui) total,
+                (ui) best
+              );
+            return 0;
+          }
+      }
+    printf(
+        "%u random sets of up to %u members: all optimal\n\n",
+        (ui) DLayoutSets,
+        (ui) DLayoutSetMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks TailAlignedSizeMulti for two known sets of objects and for random
+ * ones.  Returns zero, after saying why, if any check fails
+ */
+static int check_multi(void)
+  {
+    typedef unsigned int ui;
+    static const size_t examples[][4] =
+      {
+        { 16, 4, 4, 4 },
+        { 64, 1, 1, 1 }
+      };
+    size_t aligns[DMultiSetMax];
+    size_t count;
+    size_t i;
+    size_t offsets[4];
+    size_t set;
+    size_t sizes[DMultiSetMax];
+
+    printf("--- TailAlignedSizeMulti ---\n\n");
+    for (set = 0; set < DCountOf(examples); ++set)
+      {
+        count = DCountOf(examples[set]);
+        printf(
+            "%u objects of %u, %u, %u and %u bytes: %u bytes, at",
+            (ui) count,
+            (ui) examples[set][0],
+            (ui) examples[set][1],
+            (ui) examples[set][2],
+            (ui) examples[set][3],
+            (ui) TailAlignedSizeMulti(examples[set], NULL, count, offsets, 0)
+          );
+        for (i = 0; i < count; ++i)
+          printf(" %u", (ui) offsets[i]);
+        puts("");
+        if (!check_multi_set(examples[set], examples[set], count) ||
+          !check_multi_set(examples[set], NULL, count))
+          return 0;
+      }
+
+    for (set = 0; set < DMultiSets; ++set)
+      {
+        count = 1 + next_random(DMultiSetMax);
+        for (i = 0; i < count; ++i)
+          {
+            /* As for check_layout */
+            if (next_random(2))
+              {
+                aligns[i] = (size_t) 1 << next_random(6);
+                sizes[i] = 1 + next_random(3 * aligns[i]);
+              }
+              else
+              {
+                aligns[i] = 0;
+                sizes[i] = 1 + next_random(100);
+              }
+          }
+        if (!check_multi_set(sizes, aligns, count))
+          return 0;
+      }
+    printf(
+        "\n%u random sets of up to %u objects: as laid out naively\n\n",
+        (ui) DMultiSets,
+        (ui) DMultiSetMax
+      );
+    return 1;
+  }
+
+/*
+ * Used by check_multi.  Checks TailAlignedSizeMulti against a layout found
+ * byte by byte, with and without DAlignMultiTail.  Returns zero, after
+ * saying why, if either differs
+ */
+static int check_multi_set(
+    const size_t * sizes,
+    const size_t * aligns,
+    const size_t count
+  )
+  {
+    typedef unsigned int ui;
+    size_t align;
+    size_t end;
+    size_t i;
+    size_t max;
+    size_t naive[DMultiSetMax];
+    size_t offsets[DMultiSetMax];
+    size_t total;
+
+    for ((max = 1), (end = 0), (i = 0); i < count; ++i)
+      {
+        align = aligns && aligns[i] ?
+          aligns[i] :
+          LargestPowerOfTwoFactor(sizes[i]);
+        for (naive[i] = end; naive[i] % align; ++naive[i])
+          ;
+        end = naive[i] + sizes[i];
+        if (align > max)
+          max = align;
+      }
+    while (end % max)
+      ++end;
+
+    total = TailAlignedSizeMulti(sizes, aligns, count, offsets, 0);
+    if (total != end)
+      {
+        printf("%u bytes, but %u laid out naively\n", (ui) total, (ui) end);
+        return 0;
+      }
+    for (i = 0; i < count; ++i)
+      {
+        if (offsets[i] != naive[i])
+          {
+            printf(
+                "Object %u at %u, but at %u laid out naively\n",
+                (ui) i,
+                (ui) offsets[i],
+                (ui) naive[i]
+              );
+            return 0;
+          }
+      }
+
+    /*
+     * Moving the last object to the end should not move the others, nor
+     * change the total size, unless the object could not be aligned there
+     */
+    total = TailAlignedSizeMulti(
+        sizes,
+        aligns,
+        count,
+        offsets,
+        DAlignMultiTail
+      );
+    naive[count - 1] = end - sizes[count - 1];
+    if (sizes[count - 1] % align)
+      end = 0;
+    for (i = 0; i < count && total == end && end; ++i)
+      {
+        if (offsets[i] != naive[i])
+          break;
+      }
+    if (total != end || (end && i < count))
+      {
+        printf("%u bytes, with the last object at the end\n", (ui) total);
+        return 0;
+      }
+    return 1;
+  }
+
+/*
+ * Checks that there is a layout, that order is a permutation of the count
+ * members and that their offsets place each, aligned, within the total
+ * size and overlapping no other.  Returns zero, after saying why, if any
+ * check fails
+ */
+static int check_placement(
+    const struct layout_member * members,
+    const size_t count,
+    const size_t * order,
+    const size_t * offsets,
+    const size_t total,
+    const size_t set
+  )
+  {
+    typedef unsigned int ui;
+    size_t i;
+    size_t j;
+    int seen[DLayoutSetMax];
+
+    if (!total)
+      {
+        printf("Set %u: no layout\n", (ui) set);
+        return 0;
+      }
+    for (i = 0; i < count; ++i)
+      seen[i] = 0;
+    for (i = 0; i < count; ++i)
+      {
+        if (order[i] >= count || seen[order[i]])
+          {
+            printf("Set %u: the order is not a permutation\n", (ui) set);
+            return 0;
+          }
+        seen[order[i]] = 1;
+      }
+    for (i = 0; i < count; ++i)
+      {
+        if (offsets[i] % member_align(members + i) ||
+          offsets[i] + members[i].size > total)
+          {
+            printf("Set %u: member %u is misplaced\n", (ui) set, (ui) i);
+            return 0;
+          }
+        for (j = 0; j < i; ++j)
+          {
+            if (offsets[i] < offsets[j] + members[j].size &&
+              offsets[j] < offsets[i] + members[i].size)
+              {
+                printf(
+                    "Set %u: members %u and %u overlap\n",
+                    (ui) set,
+                    (ui) j,
+                    (ui) i
+                  );
+                return 0;
+              }
+          }
+      }
+    return 1;
+  }
+
+/*
+ * Checks TailLayoutRounded for random pairs of sizes, rounded up to
+ * nothing, random powers of two or pages: that the layout is that of
+ * TailLayoutEx with just enough padding added between the head and the
+ * tail for the total to be a multiple of the rounding, and that a bad
+ * rounding, or one which would overflow, gives what a bad alignment or an
+ * overflow would.  Returns zero, after saying why, if any check fails
+ */
+static int check_rounded(void)
+  {
+    typedef unsigned int ui;
+    size_t head_size;
+    struct tail_layout layout;
+    struct tail_layout rounded;
+    size_t round_to;
+    size_t set;
+    size_t tail_size;
+    size_t total;
+
+    printf("--- TailLayoutRounded ---\n\n");
+    for (set = 0; set < DRoundedSets; ++set)
+      {
+        head_size = 1 + next_random(DAlignPageSize);
+        tail_size = 1 + next_random(200);
+        round_to = set % 3 ?
+          (set % 3 == 1 ? DAlignPageSize : (size_t) 1 << next_random(13)) :
+          0;
+        TailLayoutEx(&layout, head_size, 0, tail_size, 0);
+        total = TailLayoutRounded(
+            &rounded,
+            head_size,
+            0,
+            tail_size,
+            0,
+            round_to
+          );
+        if (total != rounded.total_size ||
+          total < layout.total_size ||
+          (round_to && (total % round_to || total - layout.total_size >=
+            (round_to > layout.alignment ? round_to : layout.alignment))) ||
+          (!round_to && total != layout.total_size) ||
+          rounded.tail_offset + tail_size != total ||
+          rounded.padding != rounded.tail_offset - head_size ||
+          rounded.alignment != layout.alignment || rounded.overflow)
+          {
+            printf(
+                "Pair %u: %u and %u bytes, rounded to %u, in %u\n",
+                (ui) set,
+                (ui) head_size,
+                (ui) tail_size,
+                (ui) round_to,
+                (ui) total
+              );
+            return 0;
+          }
+      }
+
+    if (TailLayoutRounded(&rounded, 12, 0, 20, 0, 3000) ||
+      rounded.alignment || rounded.overflow ||
+      rounded.padding != (size_t) -1 ||
+      TailLayoutRounded(&rounded, (size_t) -1 - 2, 0, 1, 0, DAlignPageSize) ||
+      !rounded.overflow || rounded.tail_offset)
+      {
+        printf("A bad rounding: not refused\n");
+        return 0;
+      }
+    printf(
+        "%u random pairs: rounded up, with the tail at the end\n\n",
+        (ui) DRoundedSets
+      );
+    return 1;
+  }
+
+/*
+ * Checks SortSizesDescending and SortAlignmentsDescending, with and
+ * without explicit alignments, against a stable insertion sort of random
+ * arrays with many equal keys, and that an alignment offset which does not
+ * fit is refused.  Returns zero, after saying why, if any check fails
+ */
+static int check_sort(void)
+  {
+    typedef unsigned int ui;
+    size_t count;
+    struct sort_element elements[DSortMax];
+    size_t i;
+    size_t j;
+    int mode;
+    struct sort_element sorted[DSortMax];
+    size_t set;
+
+    printf("--- SortSizesDescending and SortAlignmentsDescending ---\n\n");
+    for (set = 0; set < DSortSets; ++set)
+      {
+        count = 1 + next_random(DSortMax);
+        for (i = 0; i < count; ++i)
+          {
+            elements[i].size = 1 + next_random(16);
+            elements[i].align = next_random(2) ?
+              (size_t) 1 << next_random(4) :
+              0;
+            elements[i].index = i;
+          }
+
+        /* By size, by inferred alignment and by explicit alignment */
+        mode = (int) (set % 3);
+        for (i = 0; i < count; ++i)
+          {
+            j = i;
+            while (j &&
+              precedes(elements + i, sorted + j - 1, mode, mode == 2))
+              {
+                sorted[j] = sorted[j - 1];
+                --j;
+              }
+            sorted[j] = elements[i];
+          }
+        if (!mode)
+          SortSizesDescending(&elements->size, count, sizeof *elements);
+          else
+          SortAlignmentsDescending(
+              &elements->size,
+              count,
+              sizeof *elements,
+              mode == 2 ? offsetof(struct sort_element, align) : 0
+            );
+        for (i = 0; i < count; ++i)
+          {
+            if (elements[i].index != sorted[i].index)
+              {
+                printf(
+                    "Array %u: element %u is out of order\n",
+                    (ui) set,
+                    (ui) i
+                  );
+                return 0;
+              }
+          }
+      }
+
+    /* An alignment offset beyond the element leaves the array alone */
+    elements[0].size = 1;
+    elements[1].size = 2;
+    SortAlignmentsDescending(
+        &elements->size,
+        2,
+        sizeof *elements,
+        sizeof *elements - sizeof (size_t) + 1
+      );
+    if (elements[0].size != 1)
+      {
+        printf("An offset which does not fit was used\n");
+        return 0;
+      }
+    printf(
+        "%u random arrays of up to %u elements: sorted stably\n\n",
+        (ui) DSortSets,
+        (ui) DSortMax
+      );
+    return 1;
+  }
+
+/*
+ * Checks TailAlignedStride against TailAlignedSize rounded up to random
+ * stride alignments, and that a stride alignment which is not a power of
+ * two, or a stride which would overflow, gives zero.  Returns zero, after
+ * saying why, if any check fails
+ */
+static int check_stride(void)
+  {
+    typedef unsigned int ui;
+    static const size_t bad[][3] =
+      {
+        { 0, 8, 0 },
+        { 12, 20, 48 },
+        { (size_t) -1, 1, 0 },
+        { (size_t) -1 - 62, 1, 64 }
+      };
+    size_t align;
+    size_t head_size;
+    size_t set;
+    size_t stride;
+    size_t tail_size;
+    size_t total;
+
+    printf("--- TailAlignedStride ---\n\n");
+    for (set = 0; set < DStrideSets; ++set)
+      {
+        head_size = 1 + next_random(200);
+        tail_size = 1 + next_random(200);
+        align = next_random(4) ? (size_t) 1 << next_random(13) : 0;
+        total = TailAlignedSize(head_size, tail_size);
+        stride = TailAlignedStride(head_size, tail_size, align);
+        if (stride < total ||
+          stride % LargestPowerOfTwoFactor(total) ||
+          (align && (stride % align || stride - total >= align)) ||
+          (!align && stride != total))
+          {
+            printf(
+                "Pair %u: %u and %u bytes, %u apart with %u\n",
+                (ui) set,
+                (ui) head_size,
+                (ui) tail_size,
+                (ui) stride,
+                (ui) align
+              );
+            return 0;
+          }
+      }
+    for (set = 0; set < DCountOf(bad); ++set)
+      {
+        if (TailAlignedStride(bad[set][0], bad[set][1], bad[set][2]))
+          {
+            printf("Bad pair %u: not refused\n", (ui) set);
+            return 0;
+          }
+      }
+    printf(
+        "%u random pairs: strides aligned and least\n\n",
+        (ui) DStrideSets
+      );
+    return 1;
+  }
+
 static size_t max_factor(const struct size_desc * sizes, const size_t count)
   {
     size_t factor;
@@ -126,6 +1528,79 @@ static size_t max_factor(const struct size_desc * sizes, const size_t count)
     return max;
   }
 
+/* Returns the alignment of member, as LayoutMembers takes it */
+static size_t member_align(const struct layout_member * member)
+  {
+    if (member->align)
+      return member->align;
+    return LargestPowerOfTwoFactor(member->size);
+  }
+
+/*
+ * Returns a pseudo-random number below limit, the same on any platform,
+ * so that any failure can be repeated
+ */
+static size_t next_random(const size_t limit)
+  {
+    static unsigned long state = 1;
+
+    state = (state * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    return (size_t) (state >> 16) % limit;
+  }
+
+/*
+ * Returns the size of the count members placed in the given order, each
+ * at the lowest aligned offset after the one before it
+ */
+static size_t placed_size(
+    const struct layout_member * members,
+    const size_t * order,
+    const size_t count
+  )
+  {
+    size_t align;
+    size_t i;
+    size_t max;
+    size_t offset;
+
+    for ((max = 1), (offset = 0), (i = 0); i < count; ++i)
+      {
+        align = member_align(members + order[i]);
+        offset = (offset + align - 1) & ~(align - 1);
+        offset += members[order[i]].size;
+        if (align > max)
+          max = align;
+      }
+    return (offset + max - 1) & ~(max - 1);
+  }
+
+/*
+ * Used by check_sort.  Returns non-zero if first belongs before second:
+ * by alignment, if by_alignment is non-zero, and then by size.  The
+ * alignment is the explicit one, if explicit_align is non-zero and that is
+ * non-zero, or else the factor of the size
+ */
+static int precedes(
+    const struct sort_element * first,
+    const struct sort_element * second,
+    const int by_alignment,
+    const int explicit_align
+  )
+  {
+    size_t first_align;
+    size_t second_align;
+
+    first_align = explicit_align && first->align ?
+      first->align :
+      LargestPowerOfTwoFactor(first->size);
+    second_align = explicit_align && second->align ?
+      second->align :
+      LargestPowerOfTwoFactor(second->size);
+    if (by_alignment && first_align != second_align)
+      return first_align > second_align;
+    return first->size > second->size;
+  }
+
 static void print_order(const struct size_desc * sizes, const size_t count)
   {
     typedef unsigned int ui;
@@ -135,9 +1610,71 @@ static void print_order(const struct size_desc * sizes, const size_t count)
       printf("%u: %u : %s\n", (ui) i, (ui) sizes[i].sz, sizes[i].name);
   }
 
+/*
+ * Fills members with a random set of at most DLayoutSetMax members, neither
+ * hot nor grouped, and returns how many
+ */
+static size_t random_members(struct layout_member * members)
+  {
+    size_t count;
+    size_t i;
+
+    count = 1 + next_random(DLayoutSetMax);
+    for (i = 0; i < count; ++i)
+      {
+        /*
+         * Either an explicit alignment or one implied by the size.  An
+         * explicit one need not divide the size, which is when greedy
+         * orderings can fall short and the search is needed
+         */
+        if (next_random(2))
+          {
+            members[i].align = (size_t) 1 << next_random(5);
+            members[i].size = 1 + next_random(3 * members[i].align);
+          }
+          else
+          {
+            members[i].align = 0;
+            members[i].size = 1 + next_random(24);
+          }
+        members[i].weight = 0;
+        members[i].group = 0;
+      }
+    return count;
+  }
+
+/*
+ * Returns a size up to max, which is all ones, for checking batches.  A
+ * quarter are edge cases, such as zero, the largest factor or sizes whose
+ * sums overflow, and the rest are random numbers shifted anywhere
+ */
+static size_t random_size(const size_t max)
+  {
+    size_t edges[11];
+    size_t shift;
+
+    edges[0] = 0;
+    edges[1] = 1;
+    edges[2] = 2;
+    edges[3] = 3;
+    edges[4] = max;
+    edges[5] = max - 1;
+    edges[6] = max / 2;
+    edges[7] = max / 2 + 1;
+    edges[8] = max / 4;
+    edges[9] = max / 4 + 1;
+    edges[10] = max / 4 + 2;
+    if (!next_random(4))
+      return edges[next_random(DCountOf(edges))];
+    for (shift = 0; max >> shift > 1; ++shift)
+      ;
+    return ((1 + next_random(4096)) << next_random(shift + 1)) & max;
+  }
+
 static void show_padding1(const struct size_desc * sizes, const size_t count)
   {
     size_t i;
+    struct tail_layout layout;
     unsigned int padding;
     size_t sum;
 
@@ -145,10 +1682,10 @@ static void show_padding1(const struct size_desc * sizes, const size_t count)
     printf("Assuming we build the structure member-wise-incrementally...\n");
     for ((i = 1), (sum = sizes->sz); i < count; ++i)
       {
-        padding = (unsigned int) PaddingSize(sum, sizes[i].sz);
+        sum = TailLayout(&layout, sum, sizes[i].sz);
+        padding = (unsigned int) layout.padding;
         if (padding)
           printf("%u bytes of padding before %u\n", padding, (unsigned int) i);
-        sum = TailAlignedSize(sum, sizes[i].sz);
       }
     printf("Total size: %u bytes\n\n", (unsigned int) sum);
   }
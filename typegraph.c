@@ -0,0 +1,765 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/* C >= C99 required for SIZE_MAX */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+#include "typegraph.h"
+
+/* Flags of a type */
+#define DTypeGraphDirty 1
+#define DTypeGraphChanged 2
+/* Buckets in the cache at first */
+#define DTypeGraphCacheInitial 64
+
+/*
+ * A layout in the cache, or an empty bucket if key is null.  A total size
+ * of zero is of a layout which failed, which is not used again
+ */
+struct type_graph_entry
+  {
+    size_t alignment;
+    /* Fields */
+    size_t count;
+    size_t hash;
+    /* The size and alignment of each field, then the offset of each */
+    size_t * key;
+    /*
+     * The type being laid out, during a level of TypeGraphUpdate, or
+     * DTypeGraphNone once the layout is known
+     */
+    size_t owner;
+    size_t total_size;
+  };
+
+/* What type_graph_layout needs, from TypeGraphUpdate */
+struct type_graph_work
+  {
+    struct type_graph * graph;
+    /* The members of each record, by field */
+    struct layout_member * members;
+    /* For LayoutMembers, by field */
+    size_t * order;
+    /* The records to lay out */
+    const size_t * types;
+  };
+
+static void type_graph_apply(
+    struct type_graph * Graph,
+    size_t Type,
+    const struct type_graph_entry * Entry
+  );
+static size_t type_graph_capacity(
+    size_t Capacity,
+    size_t Needed,
+    size_t Size
+  );
+static struct type_graph_entry * type_graph_find(
+    const struct type_graph * Graph,
+    const struct layout_member * Members,
+    size_t Count
+  );
+static int type_graph_grow(struct type_graph * Graph);
+static size_t type_graph_hash(
+    const struct layout_member * Members,
+    size_t Count
+  );
+static int type_graph_insert(
+    struct type_graph * Graph,
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Owner
+  );
+static void type_graph_layout(void * TaskContext, size_t Index);
+static int type_graph_prepare(
+    struct type_graph * Graph,
+    size_t Type,
+    struct layout_member * Members
+  );
+
+size_t TypeGraphAddOpaque(
+    struct type_graph * Graph,
+    size_t Size,
+    size_t Align
+  )
+  {
+    size_t capacity;
+    struct type_graph_type * type;
+    struct type_graph_type * types;
+
+    if (!Graph)
+      return DTypeGraphNone;
+    if (Graph->type_count == Graph->type_capacity)
+      {
+        capacity = type_graph_capacity(
+            Graph->type_capacity,
+            Graph->type_count + 1,
+            sizeof *types
+          );
+        types = capacity ?
+          realloc(Graph->types, capacity * sizeof *types) :
+          NULL;
+        if (!types)
+          return DTypeGraphNone;
+        Graph->types = types;
+        Graph->type_capacity = capacity;
+      }
+
+    type = Graph->types + Graph->type_count;
+    type->align = Align;
+    type->first_field = 0;
+    type->field_count = 0;
+    type->flags = DTypeGraphDirty;
+    type->level = 0;
+    type->next_align = Align;
+    type->next_size = Size;
+    type->size = Size;
+    if (!Graph->levels)
+      Graph->levels = 1;
+    return Graph->type_count++;
+  }
+
+size_t TypeGraphAddRecord(
+    struct type_graph * Graph,
+    const struct type_graph_field * Fields,
+    size_t Count
+  )
+  {
+    size_t capacity;
+    struct type_graph_field * fields;
+    size_t i;
+    size_t level;
+    size_t * offsets;
+    size_t type;
+
+    if (!Graph || !Fields || !Count ||
+      Count > SIZE_MAX - Graph->field_count)
+      return DTypeGraphNone;
+
+    /* Fields of other types place the record above them */
+    level = 1;
+    for (i = 0; i < Count; ++i)
+      {
+        if (Fields[i].type == DTypeGraphNone)
+          continue;
+        if (Fields[i].type >= Graph->type_count)
+          return DTypeGraphNone;
+        if (Graph->types[Fields[i].type].level >= level)
+          level = Graph->types[Fields[i].type].level + 1;
+      }
+
+    /* The capacity is only changed once both arrays have grown */
+    if (Graph->field_count + Count > Graph->field_capacity)
+      {
+        capacity = type_graph_capacity(
+            Graph->field_capacity,
+            Graph->field_count + Count,
+            sizeof *fields
+          );
+        if (!capacity)
+          return DTypeGraphNone;
+        fields = realloc(Graph->fields, capacity * sizeof *fields);
+        if (!fields)
+          return DTypeGraphNone;
+        Graph->fields = fields;
+        offsets = realloc(Graph->offsets, capacity * sizeof *offsets);
+        if (!offsets)
+          return DTypeGraphNone;
+        Graph->offsets = offsets;
+        Graph->field_capacity = capacity;
+      }
+
+    type = TypeGraphAddOpaque(Graph, 0, 0);
+    if (type == DTypeGraphNone)
+      return DTypeGraphNone;
+    memcpy(Graph->fields + Graph->field_count, Fields, Count * sizeof *Fields);
+    Graph->types[type].first_field = Graph->field_count;
+    Graph->types[type].field_count = Count;
+    Graph->types[type].level = level;
+    Graph->field_count += Count;
+    if (Graph->levels <= level)
+      Graph->levels = level + 1;
+    return type;
+  }
+
+size_t TypeGraphAlignment(const struct type_graph * Graph, size_t Type)
+  {
+    if (Type >= Graph->type_count)
+      return 0;
+    return Graph->types[Type].align;
+  }
+
+/*
+ * Used by TypeGraphUpdate.  Gives Type the layout of Entry, noting whether
+ * its size or alignment changed
+ */
+static void type_graph_apply(
+    struct type_graph * Graph,
+    size_t Type,
+    const struct type_graph_entry * Entry
+  )
+  {
+    struct type_graph_type * type;
+
+    type = Graph->types + Type;
+    if (type->size != Entry->total_size || type->align != Entry->alignment)
+      type->flags |= DTypeGraphChanged;
+    type->align = Entry->alignment;
+    type->size = Entry->total_size;
+    memcpy(
+        Graph->offsets + type->first_field,
+        Entry->key + 2 * Entry->count,
+        Entry->count * sizeof *Graph->offsets
+      );
+  }
+
+/*
+ * Returns a capacity of at least Needed elements of Size bytes, doubling
+ * Capacity, or zero if that would be too large
+ */
+static size_t type_graph_capacity(
+    size_t Capacity,
+    size_t Needed,
+    size_t Size
+  )
+  {
+    if (!Capacity)
+      Capacity = 16;
+    while (Capacity < Needed)
+      {
+        if (Capacity > SIZE_MAX / 2)
+          return 0;
+        Capacity *= 2;
+      }
+    if (Capacity > SIZE_MAX / Size)
+      return 0;
+    return Capacity;
+  }
+
+void TypeGraphDestroy(struct type_graph * Graph)
+  {
+    struct type_graph_entry * cache;
+    size_t i;
+
+    cache = Graph->cache;
+    for (i = 0; i < Graph->cache_capacity; ++i)
+      free(cache[i].key);
+    free(cache);
+    free(Graph->fields);
+    free(Graph->offsets);
+    free(Graph->types);
+    TypeGraphInit(Graph);
+  }
+
+/*
+ * Used by TypeGraphUpdate.  Returns the entry of the cache for the Count
+ * Members, or else the empty bucket where it would go.  The cache must not
+ * be full
+ */
+static struct type_graph_entry * type_graph_find(
+    const struct type_graph * Graph,
+    const struct layout_member * Members,
+    size_t Count
+  )
+  {
+    struct type_graph_entry * entry;
+    size_t hash;
+    size_t i;
+    size_t j;
+    size_t mask;
+
+    hash = type_graph_hash(Members, Count);
+    mask = Graph->cache_capacity - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask)
+      {
+        entry = (struct type_graph_entry *) Graph->cache + i;
+        if (!entry->key)
+          return entry;
+        if (entry->hash != hash || entry->count != Count)
+          continue;
+        for (j = 0; j < Count; ++j)
+          {
+            if (entry->key[2 * j] != Members[j].size ||
+              entry->key[2 * j + 1] != Members[j].align)
+              break;
+          }
+        if (j == Count)
+          return entry;
+      }
+  }
+
+/*
+ * Used by TypeGraphUpdate and type_graph_insert.  Doubles the buckets of
+ * the cache of Graph, or creates them.  Returns zero if there is not
+ * enough memory, leaving the cache as it was
+ */
+static int type_graph_grow(struct type_graph * Graph)
+  {
+    struct type_graph_entry * cache;
+    size_t capacity;
+    size_t i;
+    size_t j;
+    struct type_graph_entry * old;
+
+    capacity = Graph->cache_capacity ?
+      2 * Graph->cache_capacity :
+      DTypeGraphCacheInitial;
+    if (capacity < Graph->cache_capacity || capacity > SIZE_MAX / sizeof *old)
+      return 0;
+    cache = malloc(capacity * sizeof *cache);
+    if (!cache)
+      return 0;
+    for (i = 0; i < capacity; ++i)
+      cache[i].key = NULL;
+
+    /* Every entry is different, so each need only find an empty bucket */
+    old = Graph->cache;
+    for (i = 0; i < Graph->cache_capacity; ++i)
+      {
+        if (!old[i].key)
+          continue;
+        j = old[i].hash & (capacity - 1);
+        while (cache[j].key)
+          j = (j + 1) & (capacity - 1);
+        cache[j] = old[i];
+      }
+    free(old);
+    Graph->cache = cache;
+    Graph->cache_capacity = capacity;
+    return 1;
+  }
+
+/* Used by type_graph_find.  Mixes the sizes and alignments of Members */
+static size_t type_graph_hash(
+    const struct layout_member * Members,
+    size_t Count
+  )
+  {
+    size_t hash;
+    size_t i;
+
+    hash = Count;
+    for (i = 0; i < Count; ++i)
+      {
+        hash = (hash ^ Members[i].size) * 0x01000193;
+        hash ^= hash >> 15;
+        hash = (hash ^ Members[i].align) * 0x01000193;
+        hash ^= hash >> 15;
+      }
+    return hash;
+  }
+
+void TypeGraphInit(struct type_graph * Graph)
+  {
+    Graph->cache = NULL;
+    Graph->cache_capacity = 0;
+    Graph->cache_count = 0;
+    Graph->field_capacity = 0;
+    Graph->field_count = 0;
+    Graph->fields = NULL;
+    Graph->levels = 0;
+    Graph->offsets = NULL;
+    Graph->type_capacity = 0;
+    Graph->type_count = 0;
+    Graph->types = NULL;
+  }
+
+/*
+ * Used by TypeGraphUpdate.  Adds an entry to the cache of Graph for the
+ * Count Members, whose layout Owner will find.  Returns zero if there is
+ * not enough memory, in which case the layout is simply not cached
+ */
+static int type_graph_insert(
+    struct type_graph * Graph,
+    const struct layout_member * Members,
+    size_t Count,
+    size_t Owner
+  )
+  {
+    struct type_graph_entry * entry;
+    size_t i;
+    size_t * key;
+
+    /* At most half full, so that probes are short */
+    if (Graph->cache_count >= Graph->cache_capacity / 2 &&
+      !type_graph_grow(Graph))
+      return 0;
+    if (Count > SIZE_MAX / (3 * sizeof *key))
+      return 0;
+    key = malloc(3 * Count * sizeof *key);
+    if (!key)
+      return 0;
+    for (i = 0; i < Count; ++i)
+      {
+        key[2 * i] = Members[i].size;
+        key[2 * i + 1] = Members[i].align;
+      }
+
+    entry = type_graph_find(Graph, Members, Count);
+    entry->alignment = 0;
+    entry->count = Count;
+    entry->hash = type_graph_hash(Members, Count);
+    entry->key = key;
+    entry->owner = Owner;
+    entry->total_size = 0;
+    ++Graph->cache_count;
+    return 1;
+  }
+
+/*
+ * Used by TypeGraphUpdate, perhaps on many threads at once.  Lays out the
+ * record with Index in the work list of TaskContext by LayoutMembers.
+ * Only that record is changed, and the types of its fields only read
+ */
+static void type_graph_layout(void * TaskContext, size_t Index)
+  {
+    size_t first;
+    struct type_graph * graph;
+    struct layout_result layout;
+    size_t size;
+    struct type_graph_type * type;
+    const struct type_graph_work * work;
+
+    work = TaskContext;
+    graph = work->graph;
+    type = graph->types + work->types[Index];
+    first = type->first_field;
+    size = LayoutMembers(
+        work->members + first,
+        type->field_count,
+        work->order + first,
+        graph->offsets + first,
+        &layout
+      );
+    if (!size)
+      {
+        memset(
+            graph->offsets + first,
+            0,
+            type->field_count * sizeof *graph->offsets
+          );
+        layout.alignment = 0;
+      }
+    if (type->size != size || type->align != layout.alignment)
+      type->flags |= DTypeGraphChanged;
+    type->align = layout.alignment;
+    type->size = size;
+  }
+
+size_t TypeGraphOffsets(
+    const struct type_graph * Graph,
+    size_t Type,
+    size_t * Offsets
+  )
+  {
+    const struct type_graph_type * type;
+
+    if (Type >= Graph->type_count)
+      return 0;
+    type = Graph->types + Type;
+    if (Offsets && type->field_count)
+      {
+        memcpy(
+            Offsets,
+            Graph->offsets + type->first_field,
+            type->field_count * sizeof *Offsets
+          );
+      }
+    return type->size;
+  }
+
+/*
+ * Used by TypeGraphUpdate.  Fills the Members of the record Type from its
+ * fields, and clears its flags.  Returns non-zero if it is new, or if any
+ * field's type changed, so that it must be laid out again
+ */
+static int type_graph_prepare(
+    struct type_graph * Graph,
+    size_t Type,
+    struct layout_member * Members
+  )
+  {
+    const struct type_graph_field * field;
+    size_t i;
+    int stale;
+    struct type_graph_type * type;
+
+    type = Graph->types + Type;
+    stale = type->flags & DTypeGraphDirty;
+    type->flags = 0;
+    field = Graph->fields + type->first_field;
+    for (i = 0; i < type->field_count; ++i, ++field)
+      {
+        if (field->type == DTypeGraphNone)
+          {
+            Members[i].size = field->size;
+            Members[i].align = field->align;
+          }
+          else
+          {
+            Members[i].size = Graph->types[field->type].size;
+            Members[i].align = Graph->types[field->type].align;
+            stale |= Graph->types[field->type].flags & DTypeGraphChanged;
+          }
+        Members[i].weight = 0;
+        Members[i].group = 0;
+      }
+    return stale;
+  }
+
+int TypeGraphSetOpaque(
+    struct type_graph * Graph,
+    size_t Type,
+    size_t Size,
+    size_t Align
+  )
+  {
+    struct type_graph_type * type;
+
+    if (!Graph || Type >= Graph->type_count)
+      return 0;
+    type = Graph->types + Type;
+    if (type->field_count)
+      return 0;
+    if (type->size != Size || type->align != Align)
+      type->flags |= DTypeGraphDirty;
+    type->next_align = Align;
+    type->next_size = Size;
+    return 1;
+  }
+
+size_t TypeGraphSize(const struct type_graph * Graph, size_t Type)
+  {
+    if (Type >= Graph->type_count)
+      return 0;
+    return Graph->types[Type].size;
+  }
+
+int TypeGraphUpdate(
+    struct type_graph * Graph,
+    type_graph_runner * Runner,
+    void * RunnerContext,
+    struct type_graph_result * Result
+  )
+  {
+    size_t begin;
+    size_t * by_level;
+    size_t count;
+    struct type_graph_entry * entry;
+    size_t followers;
+    size_t i;
+    size_t level;
+    struct type_graph_entry * owned;
+    size_t * pending;
+    struct type_graph_result result;
+    size_t * starts;
+    struct type_graph_type * type;
+    struct type_graph_work work;
+
+    if (!Graph)
+      return 0;
+    if (!Graph->cache_capacity && !type_graph_grow(Graph))
+      return 0;
+
+    /*
+     * No count here can overflow, as each is less than that of an array
+     * of larger elements already allocated
+     */
+    by_level = malloc(
+        (2 * Graph->type_count + Graph->levels + 1 + Graph->field_count) *
+          sizeof *by_level
+      );
+    work.members = malloc(
+        (Graph->field_count ? Graph->field_count : 1) * sizeof *work.members
+      );
+    if (!by_level || !work.members)
+      {
+        free(by_level);
+        free(work.members);
+        return 0;
+      }
+    pending = by_level + Graph->type_count;
+    starts = pending + Graph->type_count;
+    work.graph = Graph;
+    work.order = starts + Graph->levels + 1;
+    work.types = pending;
+
+    /*
+     * Sort the types by level.  Afterwards, level L is from the start of
+     * level L - 1, or zero, to starts[L]
+     */
+    memset(starts, 0, (Graph->levels + 1) * sizeof *starts);
+    for (i = 0; i < Graph->type_count; ++i)
+      ++starts[Graph->types[i].level + 1];
+    for (level = 1; level <= Graph->levels; ++level)
+      starts[level] += starts[level - 1];
+    for (i = 0; i < Graph->type_count; ++i)
+      by_level[starts[Graph->types[i].level]++] = i;
+
+    /* Opaque types only change when they are given new sizes */
+    memset(&result, 0, sizeof result);
+    for (i = 0; Graph->levels && i < starts[0]; ++i)
+      {
+        type = Graph->types + by_level[i];
+        type->flags = type->flags & DTypeGraphDirty ? DTypeGraphChanged : 0;
+        if (!type->flags)
+          continue;
+        type->align = type->next_align;
+        type->size = type->next_size;
+        ++result.changed;
+      }
+
+    for (level = 1; level < Graph->levels; ++level)
+      {
+        /*
+         * Find the stale records of the level in the cache, else add them
+         * to it, to be laid out.  Those whose fields are the same as those
+         * of a record already to be laid out wait for it, at the end
+         */
+        count = 0;
+        followers = 0;
+        for (begin = starts[level - 1]; begin < starts[level]; ++begin)
+          {
+            type = Graph->types + by_level[begin];
+            if (!type_graph_prepare(
+                Graph,
+                by_level[begin],
+                work.members + type->first_field
+              ))
+              continue;
+            entry = type_graph_find(
+                Graph,
+                work.members + type->first_field,
+                type->field_count
+              );
+            if (entry->key &&
+              entry->owner == DTypeGraphNone &&
+              entry->total_size)
+              {
+                type_graph_apply(Graph, by_level[begin], entry);
+                ++result.cached;
+              }
+              else if (entry->key && entry->owner != DTypeGraphNone)
+              pending[Graph->type_count - ++followers] = by_level[begin];
+              else if (entry->key)
+              {
+                /* It failed before, so it is laid out again */
+                entry->owner = by_level[begin];
+                pending[count++] = by_level[begin];
+              }
+              else
+              {
+                type_graph_insert(
+                    Graph,
+                    work.members + type->first_field,
+                    type->field_count,
+                    by_level[begin]
+                  );
+                pending[count++] = by_level[begin];
+              }
+          }
+
+        if (Runner && count > 1)
+          Runner(RunnerContext, type_graph_layout, &work, count);
+          else
+          {
+            for (i = 0; i < count; ++i)
+              type_graph_layout(&work, i);
+          }
+
+        /*
+         * Record the new layouts in the cache, then give them to others.
+         * One which failed is recorded too, so that those waiting for it
+         * fail alike, but is laid out again when next it is needed
+         */
+        for (i = 0; i < count; ++i)
+          {
+            type = Graph->types + pending[i];
+            owned = type_graph_find(
+                Graph,
+                work.members + type->first_field,
+                type->field_count
+              );
+            if (owned->key && owned->owner == pending[i])
+              {
+                owned->alignment = type->align;
+                owned->owner = DTypeGraphNone;
+                owned->total_size = type->size;
+                memcpy(
+                    owned->key + 2 * owned->count,
+                    Graph->offsets + type->first_field,
+                    owned->count * sizeof *owned->key
+                  );
+              }
+          }
+        for (i = Graph->type_count - followers; i < Graph->type_count; ++i)
+          {
+            type = Graph->types + pending[i];
+            entry = type_graph_find(
+                Graph,
+                work.members + type->first_field,
+                type->field_count
+              );
+            type_graph_apply(Graph, pending[i], entry);
+            if (entry->total_size)
+              ++result.cached;
+          }
+
+        for (begin = starts[level - 1]; begin < starts[level]; ++begin)
+          {
+            type = Graph->types + by_level[begin];
+            if (type->flags & DTypeGraphChanged)
+              ++result.changed;
+            if (!type->size)
+              {
+                type->flags |= DTypeGraphDirty;
+                ++result.failed;
+              }
+          }
+        result.computed += count;
+      }
+
+    free(by_level);
+    free(work.members);
+    if (Result)
+      *Result = result;
+    return 1;
+  }
@@ -0,0 +1,224 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+#ifndef DIncluded_typegraph
+#define DIncluded_typegraph 1
+#include <stddef.h>
+#include "layout.h"
+/* Returned for a type which could not be added */
+#define DTypeGraphNone ((size_t) -1)
+
+/*
+ * A field of a record type, for TypeGraphAddRecord: either another type of
+ * the graph, or of a fixed size and alignment
+ */
+struct type_graph_field
+  {
+    /* The type of the field, or DTypeGraphNone for a fixed field */
+    size_t type;
+    /* For a fixed field, as for struct layout_member; otherwise ignored */
+    size_t size;
+    size_t align;
+  };
+
+/* Describes what TypeGraphUpdate did */
+struct type_graph_result
+  {
+    /* Types whose size or alignment changed, including opaque types */
+    size_t changed;
+    /* Record types laid out again by LayoutMembers */
+    size_t computed;
+    /* Record types whose layouts were found in the cache instead */
+    size_t cached;
+    /*
+     * Record types of size zero, which could not be laid out, and which are
+     * neither cached nor left clean, so that the next update tries again
+     */
+    size_t failed;
+  };
+
+/* A type of a graph.  Its members are private to typegraph.c */
+struct type_graph_type
+  {
+    /* Of the record, or as given for an opaque type */
+    size_t align;
+    /* The index of the first field of a record in the graph's fields */
+    size_t first_field;
+    /* Fields of a record, or zero for an opaque type */
+    size_t field_count;
+    /* What has happened to the type since it was last laid out */
+    int flags;
+    /* Zero for an opaque type, or one more than that of its deepest field */
+    size_t level;
+    /* As given for an opaque type, for the next TypeGraphUpdate */
+    size_t next_align;
+    size_t next_size;
+    /* Of the record, or as given for an opaque type, or zero */
+    size_t size;
+  };
+
+/*
+ * Types whose sizes depend on those of other types: opaque types, such as
+ * those from plugins, whose sizes are given and may change, and record
+ * types, whose fields may be of other types, and which are laid out by
+ * LayoutMembers.  Its members are private to typegraph.c
+ */
+struct type_graph
+  {
+    /* Buckets of layouts, by the sizes and alignments of their fields */
+    void * cache;
+    /* Buckets in the cache, a power of two, or zero */
+    size_t cache_capacity;
+    /* Layouts in the cache */
+    size_t cache_count;
+    size_t field_capacity;
+    size_t field_count;
+    /* The fields of every record, each record's together */
+    struct type_graph_field * fields;
+    /* One more than the deepest level of any type */
+    size_t levels;
+    /* The offset of each field, once laid out */
+    size_t * offsets;
+    size_t type_capacity;
+    size_t type_count;
+    struct type_graph_type * types;
+  };
+
+/* Calls a function like this for each of the Count types of a level */
+typedef void type_graph_task(void * TaskContext, size_t Index);
+/*
+ * Calls Task with TaskContext for each Index below Count, in any order and
+ * on any number of threads at once, and returns when all have returned
+ */
+typedef void type_graph_runner(
+    void * RunnerContext,
+    type_graph_task * Task,
+    void * TaskContext,
+    size_t Count
+  );
+
+#ifdef __cplusplus
+extern "C"
+  {
+#endif
+/*
+ * Adds an opaque type of Size bytes, with Align as for struct
+ * layout_member, to Graph.  Returns the index of the type, or
+ * DTypeGraphNone if Graph is null or there is not enough memory
+ */
+extern size_t TypeGraphAddOpaque(
+    struct type_graph * Graph,
+    size_t Size,
+    size_t Align
+  );
+/*
+ * Adds a record type of the Count Fields to Graph, which is laid out by
+ * the next TypeGraphUpdate.  The types of fields must have been added
+ * already, so a record cannot contain itself.  Returns the index of the
+ * type, or DTypeGraphNone if Graph or Fields is null, Count is zero, a
+ * field's type is not in Graph, or there is not enough memory
+ */
+extern size_t TypeGraphAddRecord(
+    struct type_graph * Graph,
+    const struct type_graph_field * Fields,
+    size_t Count
+  );
+/*
+ * Returns the alignment of Type, as of the last TypeGraphUpdate, or as
+ * given to TypeGraphAddOpaque for an opaque type added since, or zero for
+ * a record added since.  A change by TypeGraphSetOpaque only shows once
+ * its dependents have been laid out again
+ */
+extern size_t TypeGraphAlignment(const struct type_graph * Graph, size_t Type);
+/* Releases the storage of Graph, which may be initialized again */
+extern void TypeGraphDestroy(struct type_graph * Graph);
+/* Prepares Graph, which has no types at first */
+extern void TypeGraphInit(struct type_graph * Graph);
+/*
+ * Stores the offset of each field of the record Type into Offsets, in the
+ * order of the fields given to TypeGraphAddRecord, as of the last
+ * TypeGraphUpdate, and returns the size of the record.  For an opaque type,
+ * this stores nothing and returns its size.  Offsets may be null
+ */
+extern size_t TypeGraphOffsets(
+    const struct type_graph * Graph,
+    size_t Type,
+    size_t * Offsets
+  );
+/*
+ * Changes the size and alignment of the opaque Type, as for a reloaded
+ * plugin, for the next TypeGraphUpdate.  Returns zero if Type is not an
+ * opaque type of Graph, or else non-zero
+ */
+extern int TypeGraphSetOpaque(
+    struct type_graph * Graph,
+    size_t Type,
+    size_t Size,
+    size_t Align
+  );
+/* Returns the size of Type, as TypeGraphAlignment returns its alignment */
+extern size_t TypeGraphSize(const struct type_graph * Graph, size_t Type);
+/*
+ * Lays out every record type which is new, or which has a field of a type
+ * whose size or alignment has changed since the last update, and no other.
+ * Types are visited by level, so that the records of a level only have
+ * fields of lower levels.  The layouts of a level are found in the cache,
+ * by the sizes and alignments of their fields, if they can be, and the rest
+ * are found by LayoutMembers, through Runner with RunnerContext if Runner
+ * is non-null, so that they can be found on many threads at once.  Those
+ * layouts are then added to the cache, which keeps every distinct layout
+ * until Graph is destroyed.  A record whose layout changes but whose size
+ * and alignment do not causes no further work.  A record which
+ * LayoutMembers cannot lay out, such as for want of memory, is given a
+ * size of zero and is tried again by the next update.
+ *   If Result is non-null, it is filled in.  Returns non-zero, or zero if
+ * Graph is null or there is not enough memory to begin, in which case
+ * nothing is changed and the update may be tried again
+ */
+extern int TypeGraphUpdate(
+    struct type_graph * Graph,
+    type_graph_runner * Runner,
+    void * RunnerContext,
+    struct type_graph_result * Result
+  );
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* DIncluded_typegraph */
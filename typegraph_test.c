@@ -0,0 +1,540 @@
+/*
+ * Simple alignment demonstration
+ *
+ * Copyright (C) 2016 Synthetel Corporation. All rights reserved.
+ * Web-site: https://www.synthetel.com
+ * Author: Shao Miller <github@synthetel.com>
+ *
+ * License:
+ *   You are permitted to download, modify, compile and use this
+ * code, but you may not re-distribute it in either source-code nor compiled
+ * form unless this entire C comment-block is reproduced and distributed intact
+ * with your re-distribution, or unless you have obtained explicit permission
+ * from Synthetel Corporation.
+ * (This simple license will be reviewed, at some point.)
+ *
+ * Details:
+ *   Ordering the members of a structure from largest to smallest tends to
+ * maximize storage efficiency.  This is a small demonstration.
+ *
+ *   It is sometimes the case that you are using a library that uses an
+ * opaque structure which you might like to allocate, track, and deallocate
+ * on your own, perhaps combining the structure with other data to save the
+ * overhead of allocations or simply to keep things together for easy
+ * debugging.  If you know the size of the opaque structure, you can use
+ * the TailAlignedSize function in this code to portably determine a
+ * storage-size which is safely aligned for your own data as well as for the
+ * opaque structure, with the latter occupying the end of that storage-size.
+ *
+ *   For example, libevent2 provides the 'event_get_struct_event_size'
+ * function, which allows your program to know the size of a 'struct event'
+ * at run-time instead of at translation-time.  With this knowledge, you
+ * can determine the size you'd need to have your own contextual data with
+ * a trailing 'struct event'.  If the common case for you is to have an
+ * allocation for contextual data and an allocation for the libevent2 event,
+ * this strategy reduces your allocations by half.
+ *
+ * Simple math reveals where a trailing object begins, given the head, or
+ * where a header object begins, given the tail.
+ */
+/*
+ * A test of typegraph.c.  Sizes set for opaque types are checked to reach
+ * the records above them, level by level, and to stop at a record whose
+ * size and alignment stay the same.  Layouts are checked to come from the
+ * cache, including for records of one level which share fields, and when
+ * a size is changed back.  A Runner that visits records in reverse order
+ * is checked to give the same layouts as none.  layout.c and typegraph.c
+ * are included here, so that their allocations can be made to fail, to
+ * check that layouts which failed are tried again and never cached:
+ *
+ *   gcc -ansi -pedantic -Wall -Wextra -Werror -o typegraph_test align.c \
+ *     typegraph_test.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void * graph_malloc(size_t Size);
+static void * layout_malloc(size_t Size);
+
+#define malloc layout_malloc
+#include "layout.c"
+#undef malloc
+#define malloc graph_malloc
+#include "typegraph.c"
+#undef malloc
+
+/* The most fields of a record here */
+#define DTestFields 4
+/* Records on each level of check_runner */
+#define DTestRecords 50
+
+/* Non-zero to have the allocations of typegraph.c or layout.c fail */
+static int graph_fails;
+static int layout_fails;
+
+static int check_cache(void);
+static int check_levels(void);
+static int check_memory(void);
+static int check_result(
+    const char * What,
+    const struct type_graph_result * Result,
+    size_t Changed,
+    size_t Computed,
+    size_t Cached,
+    size_t Failed
+  );
+static int check_runner(void);
+static int check_type(
+    const struct type_graph * Graph,
+    size_t Type,
+    const struct type_graph_field * Fields,
+    size_t Count
+  );
+static void reverse_runner(
+    void * RunnerContext,
+    type_graph_task * Task,
+    void * TaskContext,
+    size_t Count
+  );
+
+int main(void)
+  {
+    int failed;
+
+    failed = check_levels();
+    failed |= check_cache();
+    failed |= check_runner();
+    failed |= check_memory();
+    if (failed)
+      return EXIT_FAILURE;
+    printf("typegraph_test: ok\n");
+    return EXIT_SUCCESS;
+  }
+
+/*
+ * Records of one level with the same fields, which are laid out once and
+ * then found in the cache, also after a size is changed and changed back
+ */
+static int check_cache(void)
+  {
+    struct type_graph_field fields[2];
+    struct type_graph graph;
+    size_t i;
+    size_t opaque;
+    size_t records[5];
+    struct type_graph_result result;
+
+    TypeGraphInit(&graph);
+    opaque = TypeGraphAddOpaque(&graph, 4, 4);
+    fields[0].type = opaque;
+    fields[1].type = DTypeGraphNone;
+    fields[1].size = 1;
+    fields[1].align = 1;
+    for (i = 0; i < 3; ++i)
+      records[i] = TypeGraphAddRecord(&graph, fields, 2);
+    /* The same sizes as the others, but fixed */
+    fields[0].type = DTypeGraphNone;
+    fields[0].size = 4;
+    fields[0].align = 4;
+    records[3] = TypeGraphAddRecord(&graph, fields, 2);
+
+    /* One is laid out, and those waiting for it follow */
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("the first update", &result, 5, 1, 3, 0))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+
+    /* The fixed one stays as it was */
+    TypeGraphSetOpaque(&graph, opaque, 8, 8);
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("an opaque change", &result, 4, 1, 2, 0) ||
+      TypeGraphSize(&graph, records[0]) != 16 ||
+      TypeGraphSize(&graph, records[3]) != 8)
+      {
+        fprintf(stderr, "typegraph_test: records shared a layout wrongly\n");
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+
+    /* Changing it back is only found in the cache */
+    TypeGraphSetOpaque(&graph, opaque, 4, 4);
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("a reverted change", &result, 4, 0, 3, 0))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+
+    /* As is the layout of a new record with the same fields */
+    records[4] = TypeGraphAddRecord(&graph, fields, 2);
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("a new record", &result, 1, 0, 1, 0))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    fields[0].type = opaque;
+    for (i = 0; i < 5; ++i)
+      {
+        if (check_type(&graph, records[i], fields, 2))
+          {
+            TypeGraphDestroy(&graph);
+            return 1;
+          }
+      }
+    TypeGraphDestroy(&graph);
+    return 0;
+  }
+
+/*
+ * A change to an opaque type, which reaches the records above it on each
+ * level, and one which stops at a record whose size stays the same
+ */
+static int check_levels(void)
+  {
+    struct type_graph_field fields[4][2];
+    struct type_graph graph;
+    size_t i;
+    size_t opaque;
+    size_t records[4];
+    struct type_graph_result result;
+    size_t small;
+    size_t stops[2];
+
+    TypeGraphInit(&graph);
+    opaque = TypeGraphAddOpaque(&graph, 8, 8);
+    for (i = 0; i < 4; ++i)
+      {
+        fields[i][0].type = i ? records[i - 1] : opaque;
+        fields[i][1].type = DTypeGraphNone;
+        fields[i][1].size = (size_t) 1 << i;
+        fields[i][1].align = (size_t) 1 << i;
+        records[i] = TypeGraphAddRecord(&graph, fields[i], 2);
+      }
+    small = TypeGraphAddOpaque(&graph, 2, 2);
+    fields[0][0].type = small;
+    fields[0][1].size = 4;
+    fields[0][1].align = 4;
+    stops[0] = TypeGraphAddRecord(&graph, fields[0], 2);
+    fields[1][0].type = stops[0];
+    stops[1] = TypeGraphAddRecord(&graph, fields[1], 2);
+    fields[0][0].type = opaque;
+    fields[0][1].size = 1;
+    fields[0][1].align = 1;
+    fields[1][0].type = records[0];
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("the first update", &result, 8, 6, 0, 0))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+
+    /* The new size only shows once it has been propagated */
+    TypeGraphSetOpaque(&graph, opaque, 24, 8);
+    if (TypeGraphSize(&graph, opaque) != 8)
+      {
+        fprintf(stderr, "typegraph_test: a size showed before an update\n");
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("an opaque change", &result, 5, 4, 0, 0) ||
+      TypeGraphSize(&graph, opaque) != 24)
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    for (i = 0; i < 4; ++i)
+      {
+        if (check_type(&graph, records[i], fields[i], 2))
+          {
+            TypeGraphDestroy(&graph);
+            return 1;
+          }
+      }
+
+    /* The record above it is 8 bytes, aligned to 4, either way */
+    TypeGraphSetOpaque(&graph, small, 3, 1);
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("an absorbed change", &result, 1, 1, 0, 0) ||
+      TypeGraphSize(&graph, stops[0]) != 8 ||
+      TypeGraphAlignment(&graph, stops[0]) != 4)
+      {
+        fprintf(stderr, "typegraph_test: a change went too far\n");
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    TypeGraphDestroy(&graph);
+    return 0;
+  }
+
+/*
+ * Updates while allocations fail.  One that cannot begin changes nothing,
+ * and layouts that LayoutMembers could not find are found by the next
+ * update, not served from the cache as failures
+ */
+static int check_memory(void)
+  {
+    struct type_graph_field fields[2];
+    struct type_graph graph;
+    size_t opaque;
+    size_t records[3];
+    struct type_graph_result result;
+
+    TypeGraphInit(&graph);
+    opaque = TypeGraphAddOpaque(&graph, 4, 4);
+    fields[0].type = opaque;
+    fields[1].type = DTypeGraphNone;
+    fields[1].size = 2;
+    fields[1].align = 2;
+    records[0] = TypeGraphAddRecord(&graph, fields, 2);
+    records[1] = TypeGraphAddRecord(&graph, fields, 2);
+    fields[0].type = records[0];
+    records[2] = TypeGraphAddRecord(&graph, fields, 2);
+
+    /* The record waiting for the first fails with it */
+    layout_fails = 1;
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("failing layouts", &result, 1, 2, 0, 3) ||
+      TypeGraphSize(&graph, records[0]) ||
+      TypeGraphSize(&graph, records[1]))
+      {
+        layout_fails = 0;
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    layout_fails = 0;
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("a retry", &result, 3, 2, 1, 0) ||
+      check_type(&graph, records[2], fields, 2))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    fields[0].type = opaque;
+    if (check_type(&graph, records[0], fields, 2) ||
+      check_type(&graph, records[1], fields, 2))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+
+    /* An update that cannot begin changes nothing */
+    TypeGraphSetOpaque(&graph, opaque, 8, 8);
+    graph_fails = 1;
+    if (TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      TypeGraphSize(&graph, opaque) != 4 ||
+      TypeGraphSize(&graph, records[0]) != 8)
+      {
+        graph_fails = 0;
+        fprintf(stderr, "typegraph_test: a failed update changed a size\n");
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    graph_fails = 0;
+    if (!TypeGraphUpdate(&graph, NULL, NULL, &result) ||
+      check_result("an update after one failed", &result, 4, 2, 1, 0) ||
+      check_type(&graph, records[0], fields, 2))
+      {
+        TypeGraphDestroy(&graph);
+        return 1;
+      }
+    TypeGraphDestroy(&graph);
+    return 0;
+  }
+
+/* Used by the checks.  Prints why Result is not as expected, if it is not */
+static int check_result(
+    const char * What,
+    const struct type_graph_result * Result,
+    size_t Changed,
+    size_t Computed,
+    size_t Cached,
+    size_t Failed
+  )
+  {
+    if (Result->changed == Changed &&
+      Result->computed == Computed &&
+      Result->cached == Cached &&
+      Result->failed == Failed)
+      return 0;
+    fprintf(
+        stderr,
+        "typegraph_test: %s changed %lu, computed %lu, cached %lu and "
+        "failed %lu types, instead of %lu, %lu, %lu and %lu\n",
+        What,
+        (unsigned long) Result->changed,
+        (unsigned long) Result->computed,
+        (unsigned long) Result->cached,
+        (unsigned long) Result->failed,
+        (unsigned long) Changed,
+        (unsigned long) Computed,
+        (unsigned long) Cached,
+        (unsigned long) Failed
+      );
+    return 1;
+  }
+
+/*
+ * Records laid out through a Runner that visits them in reverse order,
+ * compared with the same records laid out without one
+ */
+static int check_runner(void)
+  {
+    struct type_graph_field fields[2];
+    struct type_graph graphs[2];
+    size_t i;
+    size_t j;
+    size_t opaque;
+    size_t records[DTestRecords];
+    size_t runs;
+    size_t offsets[2][DTestFields];
+
+    for (i = 0; i < 2; ++i)
+      {
+        TypeGraphInit(graphs + i);
+        opaque = TypeGraphAddOpaque(graphs + i, 4, 4);
+        for (j = 0; j < DTestRecords; ++j)
+          {
+            fields[0].type = opaque;
+            fields[1].type = DTypeGraphNone;
+            fields[1].size = j + 1;
+            fields[1].align = (size_t) 1 << j % 4;
+            fields[1].size = (fields[1].size + fields[1].align - 1) &
+              ~(fields[1].align - 1);
+            records[j] = TypeGraphAddRecord(graphs + i, fields, 2);
+          }
+        for (j = 0; j + 1 < DTestRecords; ++j)
+          {
+            fields[0].type = records[j];
+            fields[1].type = records[j + 1];
+            TypeGraphAddRecord(graphs + i, fields, 2);
+          }
+      }
+
+    for (i = 0; i < 2; ++i)
+      {
+        runs = 0;
+        if (i)
+          {
+            TypeGraphSetOpaque(graphs, opaque, 12, 4);
+            TypeGraphSetOpaque(graphs + 1, opaque, 12, 4);
+          }
+        if (!TypeGraphUpdate(graphs, reverse_runner, &runs, NULL) ||
+          !TypeGraphUpdate(graphs + 1, NULL, NULL, NULL) ||
+          !runs)
+          {
+            fprintf(stderr, "typegraph_test: the runner was not used\n");
+            TypeGraphDestroy(graphs);
+            TypeGraphDestroy(graphs + 1);
+            return 1;
+          }
+        for (j = 0; j < graphs[0].type_count; ++j)
+          {
+            if (TypeGraphOffsets(graphs, j, offsets[0]) !=
+              TypeGraphOffsets(graphs + 1, j, offsets[1]) ||
+              TypeGraphAlignment(graphs, j) !=
+                TypeGraphAlignment(graphs + 1, j) ||
+              memcmp(
+                  offsets[0],
+                  offsets[1],
+                  graphs[0].types[j].field_count * sizeof **offsets
+                ))
+              {
+                fprintf(
+                    stderr,
+                    "typegraph_test: type %lu differs with the runner\n",
+                    (unsigned long) j
+                  );
+                TypeGraphDestroy(graphs);
+                TypeGraphDestroy(graphs + 1);
+                return 1;
+              }
+          }
+      }
+    TypeGraphDestroy(graphs);
+    TypeGraphDestroy(graphs + 1);
+    return 0;
+  }
+
+/*
+ * Used by the checks.  Prints why the record Type of the Count Fields is
+ * not laid out as LayoutMembers would, if it is not
+ */
+static int check_type(
+    const struct type_graph * Graph,
+    size_t Type,
+    const struct type_graph_field * Fields,
+    size_t Count
+  )
+  {
+    size_t i;
+    struct layout_result layout;
+    struct layout_member members[DTestFields];
+    size_t offsets[DTestFields];
+    size_t order[DTestFields];
+    size_t size;
+    size_t want[DTestFields];
+
+    for (i = 0; i < Count; ++i)
+      {
+        memset(members + i, 0, sizeof members[i]);
+        if (Fields[i].type == DTypeGraphNone)
+          {
+            members[i].size = Fields[i].size;
+            members[i].align = Fields[i].align;
+          }
+          else
+          {
+            members[i].size = TypeGraphSize(Graph, Fields[i].type);
+            members[i].align = TypeGraphAlignment(Graph, Fields[i].type);
+          }
+      }
+    size = LayoutMembers(members, Count, order, want, &layout);
+    if (size && size == TypeGraphOffsets(Graph, Type, offsets) &&
+      layout.alignment == TypeGraphAlignment(Graph, Type) &&
+      !memcmp(offsets, want, Count * sizeof *offsets))
+      return 0;
+    fprintf(
+        stderr,
+        "typegraph_test: type %lu is %lu bytes, aligned to %lu, instead of "
+        "%lu, aligned to %lu\n",
+        (unsigned long) Type,
+        (unsigned long) TypeGraphSize(Graph, Type),
+        (unsigned long) TypeGraphAlignment(Graph, Type),
+        (unsigned long) size,
+        (unsigned long) layout.alignment
+      );
+    return 1;
+  }
+
+/* Allocates for typegraph.c, unless graph_fails is set */
+static void * graph_malloc(size_t Size)
+  {
+    return graph_fails ? NULL : malloc(Size);
+  }
+
+/* Allocates for layout.c, unless layout_fails is set */
+static void * layout_malloc(size_t Size)
+  {
+    return layout_fails ? NULL : malloc(Size);
+  }
+
+/*
+ * A type_graph_runner which calls Task for the last index first, and
+ * counts its calls into RunnerContext
+ */
+static void reverse_runner(
+    void * RunnerContext,
+    type_graph_task * Task,
+    void * TaskContext,
+    size_t Count
+  )
+  {
+    ++*(size_t *) RunnerContext;
+    while (Count--)
+      Task(TaskContext, Count);
+  }